@@ -8,9 +8,9 @@
 #include <cassert>
 #include <iterator>
 #include <sstream>
+#include <boost/bind.hpp>
 #include <boost/foreach.hpp>
 #include <boost/filesystem.hpp>
-#include <boost/timer.hpp>
 #include <boost/shared_ptr.hpp>
 
 // AI interface/Spring includes
@@ -27,9 +27,12 @@
 #include "Unit.h"
 #include "GUI/StatusFrame.h"
 #include "Log.h"
+#include "Profiler.h"
 #include "InfluenceMap.h"
 #include "PythonScripting.h"
 #include "RNG.h"
+#include "Goal.h"
+#include "MapCache.h"
 
 
 namespace fs = boost::filesystem;
@@ -54,7 +57,9 @@ BaczekKPAI::BaczekKPAI()
 	statusName = 0;
 	influence = 0;
 	python = 0;
+	pathRequests = 0;
 	toplevel = 0;
+	pathfinderPathType = -1;
 
 	for (int i = 0; i<MAX_UNITS; ++i)
 		unitTable[i] = 0;
@@ -65,10 +70,19 @@ BaczekKPAI::BaczekKPAI()
 
 BaczekKPAI::~BaczekKPAI()
 {
-	ailog->info() << "Shutting down." << endl;
+	LOG_INFO << "Shutting down." << endl;
+	scheduler.LogStats();
+	orders.EndFrame(); // count orders of events after the last update
+	LOG_INFO << "orders total: " << orders.TotalStats() << std::endl;
+	LOG_INFO << "path cache: " << pathCache.GetStats() << std::endl;
+	python->LogHookStats();
+	profiler.LogReport();
+	profiler.WriteChromeTrace(profileName);
 	ailog->close();
 
 	// order of deletion matters
+	// pending callbacks may point into toplevel
+	delete pathRequests; pathRequests = 0;
 	delete toplevel; toplevel = 0; // <- this should delete all child groups
 
 	delete python; python = 0;
@@ -83,6 +97,7 @@ BaczekKPAI::~BaczekKPAI()
 
 void BaczekKPAI::InitAI(IGlobalAICallback* callback, int team)
 {
+	ProfilerScope profilerScope(profiler);
 	init_rng();
 
 	this->callback=callback;
@@ -107,9 +122,9 @@ void BaczekKPAI::InitAI(IGlobalAICallback* callback, int team)
 
 		std::string logname = ss.str();
 		ailog->open(logname.c_str());
-		ailog->info() << "Logging initialized.\n";
-		ailog->info() << "Baczek KP AI compiled on " __TIMESTAMP__ "\n";
-		ailog->info() << AI_NAME << " " << AI_VERSION << std::endl;
+		LOG_INFO << "Logging initialized.\n";
+		LOG_INFO << "Baczek KP AI compiled on " __TIMESTAMP__ "\n";
+		LOG_INFO << AI_NAME << " " << AI_VERSION << std::endl;
 		ss.clear();
 	}
 
@@ -120,15 +135,16 @@ void BaczekKPAI::InitAI(IGlobalAICallback* callback, int team)
 	ss << dd << "status" << team << ".txt";
 	std::string logname = ss.str();
 	statusName = strdup(logname.c_str());
+	std::stringstream profiless;
+	profiless << dd << "profile" << team << ".json";
+	profileName = profiless.str();
 	map.h = cb->GetMapHeight();
 	map.w = cb->GetMapWidth();
 	map.squareSize = SQUARE_SIZE;
 
 	float3::maxxpos = map.w * SQUARE_SIZE;
 	float3::maxzpos = map.h * SQUARE_SIZE;
-	ailog->info() << "Map size: " << float3::maxxpos << "x" << float3::maxzpos << std::endl;
-
-	FindGeovents();
+	LOG_INFO << "Map size: " << float3::maxxpos << "x" << float3::maxzpos << std::endl;
 
 	std::string influence_conf = dd+"influence.json";
 	if (!fs::is_regular_file(fs::path(influence_conf))) {
@@ -138,9 +154,24 @@ void BaczekKPAI::InitAI(IGlobalAICallback* callback, int team)
 
 	PythonScripting::RegisterAI(team, this);
 	python = new PythonScripting(team, datadir);
+	python->ExposeWorld(world, *influence);
+
+	std::string formulas_conf = dd+"formulas.json";
+	if (!fs::is_regular_file(fs::path(formulas_conf))) {
+		Formulas::WriteDefaultJSONConfig(formulas_conf);
+	}
+	formulas.Load(formulas_conf, python);
+
+	pathRequests = new PathRequestQueue(cb, pathCache);
+
+	ReloadConfig();
 
-	debugLines = python->GetIntValue("debugDrawLines", false);
-	debugMsgs = python->GetIntValue("debugMessages", false);
+	AnalyzeMap();
+
+	scheduler.AddTask("DumpStatus", 30, FrameScheduler::ANY_PHASE, 1, 100,
+			boost::bind(&BaczekKPAI::DumpStatus, this));
+	scheduler.AddTask("PathRequests", 1, 0, 3, 500,
+			boost::bind(&PathRequestQueue::Run, pathRequests, _1));
 
 	toplevel = new TopLevelAI(this);
 
@@ -163,9 +194,12 @@ void BaczekKPAI::InitAI(IGlobalAICallback* callback, int team)
 
 void BaczekKPAI::UnitCreated(int unit, int builder)
 {
-	ailog->info() << "unit created: " << unit << " by " << builder << std::endl;
+	ProfilerScope profilerScope(profiler);
+	LOG_DEBUG << "unit created: " << unit << " by " << builder << std::endl;
 	SendTextMsg("unit created", 0);
 	myUnits.insert(unit);
+	orders.ForgetUnit(unit);
+	InvalidatePaths(cb->GetUnitDef(unit), cb->GetUnitPos(unit));
 
 	assert(!unitTable[unit]);
 	unitTable[unit] = new Unit(this, unit);
@@ -176,29 +210,36 @@ void BaczekKPAI::UnitCreated(int unit, int builder)
 		toplevel->HandleExpansionCommands(unitTable[unit]);
 	else if (unitTable[unit]->is_base)
 		toplevel->HandleBaseStartCommands(unitTable[unit]);
+	FlushOrders();
 }
 
 void BaczekKPAI::UnitFinished(int unit)
 {
-	ailog->info() << "unit finished: " << unit << std::endl;
+	ProfilerScope profilerScope(profiler);
+	LOG_DEBUG << "unit finished: " << unit << std::endl;
 
 	assert(unitTable[unit]);
 	unitTable[unit]->complete();
 	toplevel->UnitFinished(unitTable[unit]);
 	toplevel->AssignUnitToGroup(unitTable[unit]);
+	FlushOrders();
 }
 
 void BaczekKPAI::UnitDestroyed(int unit,int attacker)
 {
+	ProfilerScope profilerScope(profiler);
 	float3 pos = cb->GetUnitPos(unit);
-	ailog->info() << "unit destroyed: " << unit << " at " << pos << std::endl;
+	LOG_INFO << "unit destroyed: " << unit << " at " << pos << std::endl;
 	myUnits.erase(unit);
+	orders.ForgetUnit(unit);
+	InvalidatePaths(cb->GetUnitDef(unit), pos);
 
 	assert(unitTable[unit]);
 	Unit* tmp = unitTable[unit];
 	unitTable[unit] = 0;
 	tmp->destroy(attacker);
 	delete tmp;
+	FlushOrders();
 }
 
 void BaczekKPAI::EnemyEnterLOS(int enemy)
@@ -226,22 +267,27 @@ void BaczekKPAI::EnemyDamaged(int damaged, int attacker, float damage,
 
 void BaczekKPAI::EnemyDestroyed(int enemy,int attacker)
 {
+	ProfilerScope profilerScope(profiler);
 	SendTextMsg("enemy destroyed", 0);
+	InvalidatePaths(cheatcb->GetUnitDef(enemy), cheatcb->GetUnitPos(enemy));
 	losEnemies.erase(enemy);
 	allEnemies.erase(find(allEnemies.begin(), allEnemies.end(), enemy));
 
 	Unit* unit = GetUnit(attacker);
 	toplevel->EnemyDestroyed(enemy, unit);
+	FlushOrders();
 }
 
 void BaczekKPAI::UnitIdle(int unit)
 {
+	ProfilerScope profilerScope(profiler);
 	Unit* u = GetUnit(unit);
 	assert(u);
-	ailog->info() << "unit idle " << unit << std::endl;
+	LOG_DEBUG << "unit idle " << unit << std::endl;
 	u->last_idle_frame = cb->GetCurrentFrame();
 
 	toplevel->UnitIdle(u);
+	FlushOrders();
 }
 
 void BaczekKPAI::GotChatMsg(const char* msg,int player)
@@ -250,7 +296,9 @@ void BaczekKPAI::GotChatMsg(const char* msg,int player)
 
 void BaczekKPAI::UnitDamaged(int damaged,int attacker,float damage,float3 dir)
 {
+	ProfilerScope profilerScope(profiler);
 	toplevel->UnitDamaged(GetUnit(damaged), attacker, damage, dir);
+	FlushOrders();
 }
 
 void BaczekKPAI::UnitMoveFailed(int unit)
@@ -259,14 +307,23 @@ void BaczekKPAI::UnitMoveFailed(int unit)
 
 int BaczekKPAI::HandleEvent(int msg,const void* data)
 {
-	ailog->info() << "event " << msg << std::endl;
+	LOG_INFO << "event " << msg << std::endl;
 	return 0; // signaling: OK
 }
 
+/// orders given while handling an engine event go out right away
+void BaczekKPAI::FlushOrders()
+{
+	orders.Flush(cb);
+}
+
 void BaczekKPAI::Update()
 {
-	boost::timer total;
 	int frame=cb->GetCurrentFrame();
+	ProfilerScope profilerScope(profiler);
+	// the frame record covers this update only, not engine time
+	ProfileFrame profileFrame(profiler, frame);
+	PROFILE_ZONE("BaczekKPAI::Update");
 
 	int unitids[MAX_UNITS];
 	int num = cb->GetFriendlyUnits(unitids);
@@ -286,45 +343,99 @@ void BaczekKPAI::Update()
 		std::copy(unitids, unitids+num, std::inserter(enemyBases, enemyBases.end()));
 	}
 
-	if ((frame % 30) == 0) {
-		DumpStatus();
-	}
 	influence->Update(friends, allEnemies);
 	python->GameFrame(frame);
-	// enable dynamic switching of debug info
-	debugLines = python->GetIntValue("debugDrawLines", false);
-	debugMsgs = python->GetIntValue("debugMessages", false);
+	world.Update(this, frame);
+	if (python->HasWorldFrame())
+		python->WorldFrame(world);
+	// enable dynamic switching of debug info etc.
+	if (config.IsStale())
+		ReloadConfig();
 
+	goalRegistry.ExpireGoals(frame);
 
+	scheduler.Run(frame);
 	toplevel->Update();
 
-	ailog->info() << "frame " << frame << " in " << total.elapsed() << std::endl;
+	orders.Flush(cb);
+	orders.EndFrame();
+	if (orders.LastFrameStats().given)
+		LOG_DEBUG << "orders: " << orders.LastFrameStats() << std::endl;
 }
 
 ///////////////////
 // helper methods
 
+void BaczekKPAI::ReloadConfig()
+{
+	config.Load(python);
+	debugLines = config.debugDrawLines;
+	debugMsgs = config.debugMessages;
+	ailog->SetLevel(config.logLevel);
+	scheduler.budget = config.schedulerBudget;
+	pathRequests->budget = config.pathRequestBudget;
+	python->hookBudget = config.pyHookBudget;
+	python->maxOverruns = config.pyHookMaxOverruns;
+	python->demotedPeriod = config.pyHookDemotedPeriod;
+}
+
+/// loads geovents, slopes, passability and the pathfinder graph from the
+/// map cache, or computes and saves them if it's missing or stale
+void BaczekKPAI::AnalyzeMap()
+{
+	PROFILE_ZONE("BaczekKPAI::AnalyzeMap");
+	heightmap.SetHeights(cb->GetHeightMap(), map.w, map.h);
+
+	// the grid's gradient limit is tuned for the constructors, other move
+	// types ask the engine
+	pathfinderPathType = -1;
+	BOOST_FOREACH(const UnitDef* ud, unitDefById) {
+		if (ud && ud->movedata && Unit::IsConstructor(ud)) {
+			pathfinderPathType = ud->movedata->pathType;
+			LOG_INFO << "pathfinder stands for " << ud->name << ", path type " << pathfinderPathType << std::endl;
+			break;
+		}
+	}
+
+	MapCache::Header header;
+	header.mapHash = cb->GetMapHash();
+	header.w = map.w;
+	header.h = map.h;
+	header.maxGradient = config.passabilityMaxGradient;
+
+	MapCache cache(MapCache::FileNameFor(datadir, cb->GetMapName()));
+	if (cache.Load(header, geovents, heightmap, passability, pathfinder))
+		return;
+
+	geovents.clear();
+	heightmap.BuildSlopes();
+	FindGeovents();
+	passability.Init(heightmap, config.passabilityMaxGradient);
+	pathfinder.Init(passability);
+	cache.Save(header, geovents, heightmap, passability, pathfinder);
+}
+
 void BaczekKPAI::FindGeovents()
 {
 	int features[MAX_UNITS];
 	int num = cheatcb->GetFeatures(features, MAX_UNITS);
-	ailog->info() << "found " << num << " features" << endl;
+	LOG_INFO << "found " << num << " features" << endl;
 	for (int i = 0; i<num; ++i) {
 		int featId = features[i];
 		const FeatureDef* fd = cb->GetFeatureDef(featId);
 		assert(fd);
-		ailog->info() << "found feature " << fd->myName << "\n";
+		LOG_INFO << "found feature " << fd->myName << "\n";
 		if (fd->myName != "geovent")
 			continue;
 		float3 fpos = cb->GetFeaturePos(featId);
-		ailog->info() << "found geovent at " << fpos.x << " " << fpos.z << "\n";
+		LOG_INFO << "found geovent at " << fpos.x << " " << fpos.z << "\n";
 		// check if there isn't a geovent in close proximity (there are maps
 		// with duplicate geovents)
 		BOOST_FOREACH(float3 oldpos, geovents) {
 			if (oldpos.SqDistance2D(fpos) <= 64*64)
 				goto bad_geo;
 		}
-		ailog->info() << "adding geovent" << endl;
+		LOG_INFO << "adding geovent" << endl;
 		geovents.push_back(fpos);
 bad_geo: ;
 	}
@@ -432,93 +543,30 @@ void BaczekKPAI::GetAllUnitsInRadius(std::vector<int>& vec, float3 pos, float ra
 ///////////////
 // pathfinder
 //
-// should just use GetPathLength, but it's not implemented yet!
-
-
-inline float BaczekKPAI::EstimateSqDistancePF(int unitID, const float3& start, const float3& end)
-{
-	const UnitDef* ud = cb->GetUnitDef(unitID);
-	return EstimateSqDistancePF(ud, start, end);
-}
-
-float BaczekKPAI::EstimateSqDistancePF(const UnitDef* unitdef, const float3& start, const float3& end)
-{
-	int pathId = cb->InitPath(start, end, unitdef->movedata->pathType);
-	float sqdist = 0;
-	float3 prev = start;
-
-	while(true) {
-		float3 cur;
-		do {
-			cur = cb->GetNextWaypoint(pathId);
-		} while (cur.y == -2); // y == -2 means "try again"
-
-		if (prev == cur) // end of path
-			break;
-		
-		// y == -1 means no path or end of path
-		if (cur.y < 0) {
-			if (cur.x < 0 || cur.z < 0) { // error
-				cb->FreePath(pathId);
-				return -1;
-			}
-			else {
-				// last waypoint reached
-				sqdist += cur.SqDistance2D(end);
-				// end here!
-				break;
-			}
-		} else {
-			sqdist += cur.SqDistance2D(prev);
-			prev = cur;
-		}
-	}
-
-	cb->FreePath(pathId);
-	return sqdist;
-}
-
+// engine paths are walked by pathRequests, over several frames
 
 
-inline float BaczekKPAI::EstimateDistancePF(int unitID, const float3& start, const float3& end)
+float BaczekKPAI::GetPathLength(const UnitDef* unitdef, const float3& start, const float3& end)
 {
-	const UnitDef* ud = cb->GetUnitDef(unitID);
-	return EstimateDistancePF(ud, start, end);
+	int pathType = unitdef->movedata->pathType;
+	if (pathfinder.IsValid() && pathType == pathfinderPathType)
+		return pathfinder.PathLength(start, end);
+
+	float length;
+	if (pathCache.Lookup(start, end, pathType, PathCache::PATH_LENGTH, length))
+		return length;
+	length = cb->GetPathLength(start, end, pathType);
+	pathCache.Store(start, end, pathType, PathCache::PATH_LENGTH, length);
+	return length;
 }
 
-float BaczekKPAI::EstimateDistancePF(const UnitDef* unitdef, const float3& start, const float3& end)
+/// structures change the paths around them
+void BaczekKPAI::InvalidatePaths(const UnitDef* ud, const float3& pos)
 {
-	int pathId = cb->InitPath(start, end, unitdef->movedata->pathType);
-	float dist = 0;
-	float3 prev = start;
-
-	while(true) {
-		float3 cur;
-		do {
-			cur = cb->GetNextWaypoint(pathId);
-		} while (cur.y == -2); // y == -2 means "try again"
-		
-		if (prev == cur) // end of path
-			break;
-		
-		// y == -1 means no path or end of path
-		if (cur.y < 0) {
-			if (cur.x < 0 || cur.z < 0) // error
-				return -1;
-			else {
-				// last waypoint reached
-				dist += cur.distance2D(end);
-				// end here!
-				break;
-			}
-		} else {
-			dist += cur.distance2D(prev);
-			prev = cur;
-		}
-	}
-
-	cb->FreePath(pathId);
-	return dist;
+	if (!ud || ud->speed > 0)
+		return;
+	float size = std::max(ud->xsize, ud->zsize)*SQUARE_SIZE;
+	pathCache.Invalidate(pos, size);
 }
 
 
@@ -526,19 +574,7 @@ float BaczekKPAI::EstimateDistancePF(const UnitDef* unitdef, const float3& start
 
 float BaczekKPAI::GetGroundHeight(float x, float y)
 {
-	int xsquare = int(x) / SQUARE_SIZE;
-	int ysquare = int(y) / SQUARE_SIZE;
-
-	if (xsquare < 0)
-		xsquare = 0;
-	else if (xsquare > map.w - 1)
-		xsquare = map.w - 1;
-	if (ysquare < 0)
-		ysquare = 0;
-	else if (ysquare > map.h - 1)
-		ysquare = map.h - 1;
-
-	return cb->GetHeightMap()[xsquare + ysquare * map.h];
+	return heightmap.GetHeight(x, y);
 }
 
 //////////////////////////////////////////////////////////////////
@@ -550,7 +586,7 @@ void BaczekKPAI::InitializeUnitDefs()
 	cb->GetUnitDefList(ar);
 	unitDefById.reserve(num);
 	std::copy(ar, ar+num, std::back_inserter(unitDefById));
-	ailog->info() << "loaded " << num << " unitdefs" << std::endl;
+	LOG_INFO << "loaded " << num << " unitdefs" << std::endl;
 	free(ar);
 }
 
@@ -18,7 +18,19 @@
 
 
 #include "GUI/StatusFrame.h"
+#include "Config.h"
+#include "FrameScheduler.h"
+#include "Formulas.h"
+#include "Goal.h"
+#include "HeightMap.h"
+#include "HierarchicalPathfinder.h"
 #include "InfluenceMap.h"
+#include "OrderBuffer.h"
+#include "PassabilityGrid.h"
+#include "PathCache.h"
+#include "PathRequestQueue.h"
+#include "Profiler.h"
+#include "WorldSnapshot.h"
 #include "PythonScripting.h"
 #include "TopLevelAI.h"
 
@@ -65,6 +77,9 @@ public:
 	void Update();
 
 	void DumpStatus();
+	void FlushOrders();
+	void ReloadConfig();
+	void AnalyzeMap();
 	void FindGeovents();
 
 	IGlobalAICallback* callback;
@@ -87,6 +102,7 @@ public:
 
 	const char *datadir;
 	const char *statusName;
+	std::string profileName; //<! Chrome trace written at shutdown
 
 	struct MapInfo {
 		int w, h;
@@ -99,6 +115,33 @@ public:
 
 	InfluenceMap *influence;
 	PythonScripting *python;
+	Config config;
+	Formulas formulas;
+
+	// unit arrays shared with python, refilled every frame
+	WorldSnapshot world;
+
+	// zone timings of this AI, current while the engine calls into it
+	Profiler profiler;
+
+	// periodic work of all processors, must outlive toplevel
+	FrameScheduler scheduler;
+
+	// every order goes through here, flushed at the end of Update
+	OrderBuffer orders;
+
+	// path lengths for planning, see GetPathLength
+	PathCache pathCache;
+	// engine paths measured over several frames
+	PathRequestQueue *pathRequests;
+	// terrain, built once in InitAI
+	HeightMap heightmap;
+	PassabilityGrid passability;
+	HierarchicalPathfinder pathfinder;
+	int pathfinderPathType; //<! move type the passability grid stands for, -1 if none
+
+	// goals of this AI instance, must outlive toplevel
+	GoalRegistry goalRegistry;
 
 	TopLevelAI* toplevel;
 
@@ -118,11 +161,16 @@ public:
 	
 	void GetAllUnitsInRadius(std::vector<int>& vec, float3 pos, float radius);
 
-	float EstimateSqDistancePF(int unitID, const float3& start, const float3& end);
-	float EstimateSqDistancePF(const UnitDef* unitdef, const float3& start, const float3& end);
-	// slower versions for precise distance
-	float EstimateDistancePF(int unitID, const float3& start, const float3& end);
-	float EstimateDistancePF(const UnitDef* unitdef, const float3& start, const float3& end);
+	/// path length from our own pathfinder, the engine's (cached) before it's
+	/// built or for other move types than pathfinderPathType
+	///
+	/// Waypoint sums of engine paths are measured by pathRequests.
+	float GetPathLength(const UnitDef* unitdef, const float3& start, const float3& end);
+
+protected:
+	void InvalidatePaths(const UnitDef* ud, const float3& pos);
+
+public:
 
 	// heightmap
 	float GetGroundHeight(float x, float y);
@@ -143,7 +191,7 @@ public:
 	{
 		const char* side = cb->GetTeamSide(cb->GetMyTeam());
 		std::string configval = (std::string(side)+"_"+role);
-		return python->GetStringValue(configval.c_str(), std::string());
+		return config.GetString(configval, std::string());
 	}
 
 	void SendTextMsg(const char *msg, int zone)
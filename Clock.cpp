@@ -0,0 +1,35 @@
+#ifdef _WIN32
+#	define WIN32_LEAN_AND_MEAN
+#	include <windows.h>
+#else
+#	include <time.h>
+#endif
+
+#include "Clock.h"
+
+
+#ifdef _WIN32
+
+boost::int64_t GetMicroseconds()
+{
+	static LARGE_INTEGER frequency;
+	static bool initialized = false;
+	if (!initialized) {
+		QueryPerformanceFrequency(&frequency);
+		initialized = true;
+	}
+	LARGE_INTEGER now;
+	QueryPerformanceCounter(&now);
+	return (boost::int64_t)(now.QuadPart * 1000000.0 / frequency.QuadPart);
+}
+
+#else
+
+boost::int64_t GetMicroseconds()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (boost::int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+#endif
@@ -0,0 +1,7 @@
+#pragma once
+
+#include <boost/cstdint.hpp>
+
+/// monotonic high resolution clock, microseconds since an arbitrary point
+/// only differences between two calls are meaningful
+boost::int64_t GetMicroseconds();
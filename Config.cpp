@@ -0,0 +1,125 @@
+#include "BaczekKPAI.h"
+#include "PythonScripting.h"
+#include "Log.h"
+#include "Config.h"
+
+
+Config::Config():
+		version(-1), python(0)
+{
+	importantRadius = 1000;
+	battleGroupHealthRetreatLimit = 0.2f;
+	attackStateChangeTimeout = 90*GAME_SPEED;
+	retreatGroupTimeout = 15*GAME_SPEED;
+	gatherMinOffset = 256;
+	gatherMaxOffset = 768;
+	baseDefenseRadius = 1536;
+	rushBaseUnitCount = 250;
+	pr_MOVEOnAttack = 0.1f;
+	formationSpacing = 48;
+	formationAspectRatio = 4;
+	formationMaxExact = 100;
+
+	maxBaseStuckCount = 3;
+	baseSearchRadius = 16;
+	spam_radius = 384;
+
+	builderRetreatMaxDist = 40*SQUARE_SIZE;
+	builderRetreatMinDist = 10*SQUARE_SIZE;
+	builderRetreatCheckOffset = 10*SQUARE_SIZE;
+	expansionInfluenceLimit = 0;
+	plannerBudget = 1000;
+	plannerMaxAge = 5*GAME_SPEED;
+	passabilityMaxGradient = 1.0f;
+	pathRequestBudget = 1000;
+
+	schedulerBudget = 5000;
+	pyHookBudget = 10000;
+	pyHookMaxOverruns = 3;
+	pyHookDemotedPeriod = GAME_SPEED;
+	logLevel = Log::LVL_INFO;
+	debugDrawLines = false;
+	debugMessages = false;
+}
+
+
+#define CONFIG_INT(name) name = python->GetIntValue(#name, name)
+#define CONFIG_FLOAT(name) name = python->GetFloatValue(#name, name)
+
+void Config::Load(PythonScripting* py)
+{
+	python = py;
+	// read the version first, a change made while loading triggers another load
+	version = PythonScripting::GetConfigVersion();
+
+	CONFIG_FLOAT(importantRadius);
+	CONFIG_FLOAT(battleGroupHealthRetreatLimit);
+	CONFIG_INT(attackStateChangeTimeout);
+	CONFIG_INT(retreatGroupTimeout);
+	CONFIG_FLOAT(gatherMinOffset);
+	CONFIG_FLOAT(gatherMaxOffset);
+	CONFIG_FLOAT(baseDefenseRadius);
+	CONFIG_INT(rushBaseUnitCount);
+	CONFIG_FLOAT(pr_MOVEOnAttack);
+	CONFIG_FLOAT(formationSpacing);
+	CONFIG_FLOAT(formationAspectRatio);
+	CONFIG_INT(formationMaxExact);
+
+	CONFIG_INT(maxBaseStuckCount);
+	CONFIG_FLOAT(baseSearchRadius);
+	CONFIG_FLOAT(spam_radius);
+
+	CONFIG_INT(builderRetreatMaxDist);
+	CONFIG_INT(builderRetreatMinDist);
+	CONFIG_INT(builderRetreatCheckOffset);
+	CONFIG_INT(expansionInfluenceLimit);
+	CONFIG_INT(plannerBudget);
+	CONFIG_INT(plannerMaxAge);
+	CONFIG_FLOAT(passabilityMaxGradient);
+	CONFIG_INT(pathRequestBudget);
+
+	CONFIG_INT(schedulerBudget);
+	CONFIG_INT(pyHookBudget);
+	CONFIG_INT(pyHookMaxOverruns);
+	CONFIG_INT(pyHookDemotedPeriod);
+	CONFIG_INT(logLevel);
+	debugDrawLines = python->GetIntValue("debugDrawLines", debugDrawLines);
+	debugMessages = python->GetIntValue("debugMessages", debugMessages);
+
+	floatCache.clear();
+	stringCache.clear();
+
+	LOG_INFO << "config version " << version << " loaded" << std::endl;
+}
+
+#undef CONFIG_INT
+#undef CONFIG_FLOAT
+
+
+bool Config::IsStale() const
+{
+	return version != PythonScripting::GetConfigVersion();
+}
+
+
+float Config::GetFloat(const std::string& name, float def)
+{
+	std::map<std::string, float>::iterator it = floatCache.find(name);
+	if (it != floatCache.end())
+		return it->second;
+	assert(python);
+	float value = python->GetFloatValue(name.c_str(), def);
+	floatCache.insert(std::make_pair(name, value));
+	return value;
+}
+
+std::string Config::GetString(const std::string& name, const std::string& def)
+{
+	std::map<std::string, std::string>::iterator it = stringCache.find(name);
+	if (it != stringCache.end())
+		return it->second;
+	assert(python);
+	std::string value = python->GetStringValue(name.c_str(), def);
+	stringCache.insert(std::make_pair(name, value));
+	return value;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <map>
+#include <string>
+
+class PythonScripting;
+
+/// configuration values resolved from python once
+///
+/// Reading a field is a plain load. The snapshot is reloaded when python
+/// reports a change (set_config_value in init.py), see IsStale.
+/// Values with names only known at runtime (e.g. <unit>_radius) are
+/// looked up on first use and cached until the next reload.
+class Config
+{
+public:
+	Config();
+
+	/// load all values, python must be initialized
+	void Load(PythonScripting* python);
+	bool IsStale() const;
+
+	int version; //<! python config version this snapshot was loaded from
+
+	// battle groups
+	float importantRadius;
+	float battleGroupHealthRetreatLimit;
+	int attackStateChangeTimeout;
+	int retreatGroupTimeout;
+	float gatherMinOffset;
+	float gatherMaxOffset;
+	float baseDefenseRadius;
+	int rushBaseUnitCount;
+	float pr_MOVEOnAttack;
+	float formationSpacing;
+	float formationAspectRatio;
+	int formationMaxExact;
+
+	// units
+	int maxBaseStuckCount;
+	float baseSearchRadius;
+	float spam_radius;
+
+	// builders and expansions
+	int builderRetreatMaxDist;
+	int builderRetreatMinDist;
+	int builderRetreatCheckOffset;
+	int expansionInfluenceLimit;
+	int plannerBudget;
+	int plannerMaxAge;
+	float passabilityMaxGradient;
+	int pathRequestBudget;
+
+	// misc
+	int schedulerBudget;
+	int pyHookBudget;
+	int pyHookMaxOverruns;
+	int pyHookDemotedPeriod;
+	int logLevel;
+	bool debugDrawLines;
+	bool debugMessages;
+
+	float GetFloat(const std::string& name, float def);
+	std::string GetString(const std::string& name, const std::string& def);
+
+protected:
+	PythonScripting* python;
+
+	std::map<std::string, float> floatCache;
+	std::map<std::string, std::string> stringCache;
+};
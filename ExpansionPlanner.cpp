@@ -0,0 +1,285 @@
+#include <algorithm>
+#include <boost/bind.hpp>
+#include <boost/foreach.hpp>
+
+#include "Sim/MoveTypes/MoveInfo.h"
+
+#include "Log.h"
+#include "Clock.h"
+#include "BaczekKPAI.h"
+#include "TopLevelAI.h"
+#include "Unit.h"
+#include "ExpansionPlanner.h"
+
+
+ExpansionPlanner::ExpansionPlanner(TopLevelAI* o):
+		budget(1000), maxAge(150), owner(o), probePathType(-1), influenceLimit(0),
+		startFrame(0), first(0), checked(0), resumeAt(0),
+		pending(0), planId(0), running(false)
+{
+}
+
+
+void ExpansionPlanner::Start(int frame)
+{
+	BaczekKPAI* ai = owner->ai;
+
+	spots.clear();
+	BOOST_FOREACH(const float3& geo, ai->geovents) {
+		spots.push_back(Spot(geo, ai->influence->GetAtXY(geo.x, geo.z)));
+	}
+
+	bases.clear();
+	for (UnitGroupAI::UnitAISet::iterator it = owner->bases->units.begin();
+			it != owner->bases->units.end(); ++it) {
+		bases.push_back(ai->cb->GetUnitPos(it->first));
+	}
+	baseDistance.Compute(ai->passability, bases);
+	baseComponents.clear();
+	BOOST_FOREACH(const float3& pos, bases) {
+		// a base on a cell without passable neighbours tells nothing
+		int component = ai->passability.Component(pos);
+		if (component != PassabilityGrid::NO_COMPONENT)
+			baseComponents.push_back(component);
+	}
+	if (baseComponents.empty() && !bases.empty())
+		LOG_INFO << "no base is on passable ground, not filtering spots by component" << std::endl;
+
+	probePathType = -1;
+	for (UnitGroupAI::UnitAISet::iterator it = owner->builders->units.begin();
+			it != owner->builders->units.end(); ++it) {
+		const UnitDef* ud = ai->cb->GetUnitDef(it->first);
+		if (ud && ud->movedata) {
+			probePathType = ud->movedata->pathType;
+			break;
+		}
+	}
+
+	influenceLimit = ai->config.expansionInfluenceLimit;
+	budget = ai->config.plannerBudget;
+	maxAge = ai->config.plannerMaxAge;
+
+	startFrame = frame;
+	first = spots.empty() ? 0 : resumeAt % spots.size();
+	checked = 0;
+	pending = 0;
+	++planId;
+	candidates.clear();
+	plan.clear();
+	running = true;
+}
+
+void ExpansionPlanner::Cancel()
+{
+	running = false;
+	pending = 0;
+	++planId;
+	spots.clear();
+	bases.clear();
+	baseDistance.clear();
+	candidates.clear();
+	plan.clear();
+}
+
+
+bool ExpansionPlanner::Step(int frame)
+{
+	if (!running)
+		return false;
+
+	// always make progress, even if the budget is tiny
+	boost::int64_t start = GetMicroseconds();
+	do {
+		if (checked >= spots.size())
+			break;
+		size_t i = (first + checked) % spots.size();
+		if (CheckSpot(i))
+			candidates.push_back(i);
+		++checked;
+	} while (GetMicroseconds() - start < budget);
+
+	if (checked < spots.size() || pending > 0) {
+		if (frame - startFrame <= maxAge)
+			return false;
+		// don't throw the work away, the next plan picks up where this one stopped
+		LOG_INFO << "expansion plan from frame " << startFrame << " is too old, finishing with "
+			<< checked << " of " << spots.size() << " spots, "
+			<< pending << " engine paths unanswered" << std::endl;
+	}
+	resumeAt = first + checked;
+
+	std::vector<int> priorities;
+	ScoreCandidates(priorities);
+	for (size_t i = 0; i < candidates.size(); ++i)
+		PlanGoal(spots[candidates[i]], priorities[i]);
+
+	LOG_INFO << "expansion plan from frame " << startFrame << " done: "
+		<< plan.add.size() << " new goals, " << plan.abort.size() << " aborted, "
+		<< plan.badSpots.size() << " bad spots" << std::endl;
+	running = false;
+	pending = 0;
+	return true;
+}
+
+
+bool ExpansionPlanner::CheckSpot(size_t i)
+{
+	BaczekKPAI* ai = owner->ai;
+	Spot& spot = spots[i];
+	const float3& geo = spot.pos;
+
+	// islands and spots behind cliffs, or so the grid says
+	if (!baseComponents.empty()) {
+		int component = ai->passability.Component(geo);
+		if (std::find(baseComponents.begin(), baseComponents.end(), component) == baseComponents.end()) {
+			RequestEnginePath(i);
+			return false;
+		}
+	}
+
+	if (IsTaken(geo))
+		return false;
+
+	spot.distance = baseDistance.Distance(geo);
+
+	// can't reach
+	if (spot.distance < 0) {
+		LOG_INFO << "can't reach geo at " << geo << std::endl;
+		return false;
+	}
+
+	return IsSafe(spot);
+}
+
+
+bool ExpansionPlanner::IsTaken(const float3& geo)
+{
+	BaczekKPAI* ai = owner->ai;
+
+	// check if the expansion spot is taken
+	std::vector<int> stuff;
+	ai->GetAllUnitsInRadius(stuff, geo, 8);
+	BOOST_FOREACH(int id, stuff) {
+		// TODO switch to CanBuildAt?
+		const UnitDef* ud = ai->cheatcb->GetUnitDef(id);
+		bool alive = ai->cheatcb->GetUnitHealth(id) > 0;
+		assert(ud);
+		// TODO make configurable
+		if (alive && (Unit::IsBase(ud) || Unit::IsExpansion(ud) || Unit::IsSuperWeapon(ud))) {
+			LOG_INFO << "found blocking " << ud->name << " at  " << ai->cheatcb->GetUnitPos(id) << std::endl;
+			LOG_INFO << geo << " is a bad spot" << std::endl;
+			plan.badSpots.push_back(geo);
+			return true;
+		}
+	}
+	return false;
+}
+
+
+bool ExpansionPlanner::IsSafe(const Spot& spot) const
+{
+	if (spot.influence < influenceLimit) {
+		LOG_INFO << "too risky to build an expansion at " << spot.pos << std::endl;
+		return false;
+	}
+	return true;
+}
+
+
+/// the grid says the spot can't be reached, let the engine have the last word
+void ExpansionPlanner::RequestEnginePath(size_t i)
+{
+	const float3& geo = spots[i].pos;
+	if (probePathType < 0 || bases.empty()) {
+		LOG_INFO << "can't reach geo at " << geo << " (passability grid, no builder or base to ask the engine with)" << std::endl;
+		return;
+	}
+
+	// measured from a base like the flow field distances, so scores compare
+	const float3* start = &bases[0];
+	BOOST_FOREACH(const float3& pos, bases) {
+		if (pos.SqDistance2D(geo) < start->SqDistance2D(geo))
+			start = &pos;
+	}
+
+	LOG_DEBUG << "geo at " << geo << " is cut off on the passability grid, asking the engine" << std::endl;
+	// counted first, a cached answer comes back before Request returns
+	++pending;
+	owner->ai->pathRequests->Request(probePathType, *start, geo, PathCache::WAYPOINT_SUM,
+			boost::bind(&ExpansionPlanner::EnginePathDone, this, planId, i, _1));
+}
+
+void ExpansionPlanner::EnginePathDone(int id, size_t i, float length)
+{
+	if (id != planId || !running)
+		return;
+	--pending;
+
+	Spot& spot = spots[i];
+	if (length < 0) {
+		LOG_INFO << "can't reach geo at " << spot.pos << " (passability grid and engine path)" << std::endl;
+		return;
+	}
+	LOG_INFO << "geo at " << spot.pos << " is cut off on the passability grid, but the engine found a path" << std::endl;
+
+	if (IsTaken(spot.pos))
+		return;
+	// the flow field can't cross the gap either, use the engine's length
+	spot.distance = length;
+	if (IsSafe(spot))
+		candidates.push_back(i);
+}
+
+
+/// one batched call for all candidates, the built-in formula if none is set up
+void ExpansionPlanner::ScoreCandidates(std::vector<int>& priorities)
+{
+	BaczekKPAI* ai = owner->ai;
+	priorities.clear();
+	if (candidates.empty())
+		return;
+
+	std::vector<float> distances;
+	std::vector<int> influences;
+	distances.reserve(candidates.size());
+	influences.reserve(candidates.size());
+	BOOST_FOREACH(size_t i, candidates) {
+		distances.push_back(spots[i].distance);
+		influences.push_back(spots[i].influence);
+	}
+
+	if (ai->formulas.GetBuildSpotPriorities(distances, influences,
+			ai->map.w, ai->map.h, priorities))
+		return;
+
+	float k = 15;
+	float divider = (float)(ai->map.w + ai->map.h);
+	priorities.resize(candidates.size());
+	for (size_t i = 0; i < candidates.size(); ++i)
+		priorities[i] = influences[i] - (int)((distances[i]/divider)*k);
+}
+
+
+void ExpansionPlanner::PlanGoal(const Spot& spot, int priority)
+{
+	const float3& geo = spot.pos;
+	LOG_INFO << "geo at " << geo << " distance to nearest base " << spot.distance
+		<< " influence " << spot.influence << " priority " << priority << std::endl;
+
+	// check if there already is a goal with this position
+	std::vector<int> sameSpot;
+	std::vector<int> replaced;
+	owner->index.FindGoalsNear(BUILD_EXPANSION, geo, 1, sameSpot);
+	BOOST_FOREACH(int gid, sameSpot) {
+		Goal* goal = owner->goalRegistry->GetGoal(gid);
+		if (!goal)
+			continue;
+		// try to avoid duplicate goals, don't abort goals which are being executed
+		if (goal->priority == priority || goal->is_executing())
+			return;
+		replaced.push_back(gid);
+	}
+
+	plan.abort.insert(plan.abort.end(), replaced.begin(), replaced.end());
+	plan.add.push_back(NewGoal(geo, priority));
+}
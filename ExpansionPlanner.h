@@ -0,0 +1,93 @@
+#pragma once
+
+#include <vector>
+
+#include "float3.h"
+#include "FlowField.h"
+
+class TopLevelAI;
+
+/// scores expansion spots over several frames and builds a plan diff
+///
+/// Start collects the spots with the influence on them and computes the
+/// distances to bases, in one flow field instead of a path per spot. Step
+/// checks spots against the current units and goals until its time
+/// budget runs out. The passability grid is coarse and may cut off a spot
+/// which can be reached, so for a spot outside the bases' components the
+/// engine is asked for a path from the nearest base (through
+/// PathRequestQueue) before it's dropped. The spots that pass are scored together in one call when all
+/// are checked and all engine paths are in. Existing goals are never
+/// touched here: the finished plan lists goals to add and abort, and
+/// TopLevelAI applies it after checking each change is still valid.
+/// A plan older than maxAge frames is finished with the spots checked so
+/// far, and the next plan starts with the spots that were left out.
+class ExpansionPlanner
+{
+public:
+	ExpansionPlanner(TopLevelAI* owner);
+
+	struct NewGoal {
+		float3 pos;
+		int priority;
+		NewGoal(const float3& p, int prio):pos(p), priority(prio) {}
+	};
+
+	struct Plan {
+		std::vector<NewGoal> add;
+		std::vector<int> abort; //<! goals replaced by a goal with a new priority
+		std::vector<float3> badSpots; //<! spots which can't be expanded on
+		void clear() { add.clear(); abort.clear(); badSpots.clear(); }
+	};
+
+	int budget; //<! microseconds per Step
+	int maxAge; //<! frames
+
+	bool IsRunning() const { return running; }
+	void Start(int frame);
+	void Cancel();
+	/// returns true when the plan has just been completed
+	bool Step(int frame);
+
+	const Plan& GetPlan() const { return plan; }
+
+protected:
+	TopLevelAI* owner;
+
+	struct Spot {
+		float3 pos;
+		int influence;
+		/// path length to the nearest base, set once checked; for a spot only
+		/// the engine reaches, from the base closest in a straight line
+		float distance;
+		Spot(const float3& p, int i):pos(p), influence(i), distance(-1) {}
+	};
+
+	// snapshot
+	std::vector<Spot> spots;
+	std::vector<float3> bases; //<! positions of our bases
+	FlowField baseDistance; //<! distance to the nearest base
+	std::vector<int> baseComponents; //<! passability components with a base, empty if none has one
+	int probePathType; //<! path type of engine path checks, a builder's, -1 if there's none
+	int influenceLimit;
+	int startFrame;
+
+	size_t first; //<! spot the plan started with
+	size_t checked; //<! spots done, from first on and wrapping around
+	size_t resumeAt; //<! first spot of the next plan
+	int pending; //<! engine path checks not answered yet
+	int planId; //<! tells answers for older plans apart
+	bool running;
+	Plan plan;
+
+	std::vector<size_t> candidates; //<! indices of spots worth a goal
+
+	/// returns true if a goal could be placed on the spot
+	bool CheckSpot(size_t i);
+	/// returns true and records a bad spot if it's built on
+	bool IsTaken(const float3& geo);
+	bool IsSafe(const Spot& spot) const;
+	void RequestEnginePath(size_t i);
+	void EnginePathDone(int id, size_t i, float length);
+	void ScoreCandidates(std::vector<int>& priorities);
+	void PlanGoal(const Spot& spot, int priority);
+};
@@ -0,0 +1,402 @@
+#include <cassert>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <algorithm>
+
+#include "Expression.h"
+
+
+/////////////////////////////////////////
+// parser
+
+/// recursive descent parser emitting postfix code into an Expression
+class ExpressionParser
+{
+public:
+	ExpressionParser(Expression& e, const std::vector<std::string>& in,
+			const Expression::Constants& c):
+			expr(e), inputs(in), constants(c), pos(0), depth(0), maxDepth(0) {}
+
+	bool Parse()
+	{
+		if (!ParseComparison())
+			return false;
+		SkipSpace();
+		if (pos < src().size())
+			return Fail("unexpected '" + src().substr(pos, 1) + "'");
+		return true;
+	}
+
+protected:
+	Expression& expr;
+	const std::vector<std::string>& inputs;
+	const Expression::Constants& constants;
+	size_t pos;
+	int depth, maxDepth;
+
+	const std::string& src() const { return expr.source; }
+
+	bool Fail(const std::string& msg)
+	{
+		if (expr.error.empty()) {
+			std::ostringstream os;
+			os << msg << " at column " << pos+1;
+			expr.error = os.str();
+		}
+		return false;
+	}
+
+	void SkipSpace()
+	{
+		while (pos < src().size() && isspace((unsigned char)src()[pos]))
+			++pos;
+	}
+
+	bool Accept(const char* token)
+	{
+		SkipSpace();
+		size_t len = strlen(token);
+		if (src().compare(pos, len, token) != 0)
+			return false;
+		pos += len;
+		return true;
+	}
+
+	bool Expect(const char* token)
+	{
+		if (Accept(token))
+			return true;
+		return Fail(std::string("expected '") + token + "'");
+	}
+
+	bool Emit(Expression::OpCode op, int input = 0, float value = 0)
+	{
+		std::vector<Expression::Op>& code = expr.code;
+		int arity = Expression::Arity(op);
+
+		// fold operations on constants
+		if (op != Expression::OP_CONST && op != Expression::OP_INPUT
+				&& (int)code.size() >= arity) {
+			bool allConst = true;
+			float args[3] = {0, 0, 0};
+			for (int i = 0; i < arity; ++i) {
+				const Expression::Op& arg = code[code.size() - arity + i];
+				allConst = allConst && arg.code == Expression::OP_CONST;
+				args[i] = arg.value;
+			}
+			if (allConst) {
+				code.erase(code.end() - arity, code.end());
+				code.push_back(Expression::Op(Expression::OP_CONST, 0,
+						Expression::Apply(op, args[0], args[1], args[2])));
+				depth -= arity - 1;
+				return true;
+			}
+		}
+
+		code.push_back(Expression::Op(op, input, value));
+		depth += 1 - arity;
+		maxDepth = std::max(maxDepth, depth);
+		if (maxDepth > Expression::MAX_STACK)
+			return Fail("expression too deep");
+		return true;
+	}
+
+	bool ParseComparison()
+	{
+		if (!ParseSum())
+			return false;
+		for (;;) {
+			Expression::OpCode op;
+			if (Accept("<="))
+				op = Expression::OP_LE;
+			else if (Accept(">="))
+				op = Expression::OP_GE;
+			else if (Accept("=="))
+				op = Expression::OP_EQ;
+			else if (Accept("!="))
+				op = Expression::OP_NE;
+			else if (Accept("<"))
+				op = Expression::OP_LT;
+			else if (Accept(">"))
+				op = Expression::OP_GT;
+			else
+				return true;
+			if (!ParseSum() || !Emit(op))
+				return false;
+		}
+	}
+
+	bool ParseSum()
+	{
+		if (!ParseProduct())
+			return false;
+		for (;;) {
+			Expression::OpCode op;
+			if (Accept("+"))
+				op = Expression::OP_ADD;
+			else if (Accept("-"))
+				op = Expression::OP_SUB;
+			else
+				return true;
+			if (!ParseProduct() || !Emit(op))
+				return false;
+		}
+	}
+
+	bool ParseProduct()
+	{
+		if (!ParseUnary())
+			return false;
+		for (;;) {
+			Expression::OpCode op;
+			if (Accept("*"))
+				op = Expression::OP_MUL;
+			else if (Accept("/"))
+				op = Expression::OP_DIV;
+			else if (Accept("%"))
+				op = Expression::OP_MOD;
+			else
+				return true;
+			if (!ParseUnary() || !Emit(op))
+				return false;
+		}
+	}
+
+	bool ParseUnary()
+	{
+		if (Accept("-"))
+			return ParseUnary() && Emit(Expression::OP_NEG);
+		if (Accept("+"))
+			return ParseUnary();
+		return ParsePrimary();
+	}
+
+	bool ParsePrimary()
+	{
+		SkipSpace();
+		if (pos >= src().size())
+			return Fail("unexpected end");
+
+		char c = src()[pos];
+		if (Accept("("))
+			return ParseComparison() && Expect(")");
+
+		if (isdigit((unsigned char)c) || c == '.') {
+			const char* start = src().c_str() + pos;
+			char* end;
+			float value = (float)strtod(start, &end);
+			if (end == start)
+				return Fail("bad number");
+			pos += end - start;
+			return Emit(Expression::OP_CONST, 0, value);
+		}
+
+		if (isalpha((unsigned char)c) || c == '_') {
+			size_t start = pos;
+			while (pos < src().size()
+					&& (isalnum((unsigned char)src()[pos]) || src()[pos] == '_'))
+				++pos;
+			std::string name = src().substr(start, pos - start);
+			if (Accept("("))
+				return ParseCall(name);
+
+			std::vector<std::string>::const_iterator in =
+				std::find(inputs.begin(), inputs.end(), name);
+			if (in != inputs.end())
+				return Emit(Expression::OP_INPUT, in - inputs.begin());
+			Expression::Constants::const_iterator k = constants.find(name);
+			if (k != constants.end())
+				return Emit(Expression::OP_CONST, 0, k->second);
+			pos = start;
+			return Fail("unknown name '" + name + "'");
+		}
+
+		return Fail(std::string("unexpected '") + c + "'");
+	}
+
+	bool ParseCall(const std::string& name)
+	{
+		static const struct {
+			const char* name;
+			Expression::OpCode op;
+		} functions[] = {
+			{ "abs", Expression::OP_ABS },
+			{ "floor", Expression::OP_FLOOR },
+			{ "ceil", Expression::OP_CEIL },
+			{ "sqrt", Expression::OP_SQRT },
+			{ "min", Expression::OP_MIN },
+			{ "max", Expression::OP_MAX },
+			{ "clamp", Expression::OP_CLAMP },
+			{ "if", Expression::OP_SELECT },
+		};
+
+		for (size_t i = 0; i < sizeof(functions)/sizeof(functions[0]); ++i) {
+			if (name != functions[i].name)
+				continue;
+			int arity = Expression::Arity(functions[i].op);
+			for (int arg = 0; arg < arity; ++arg) {
+				if (arg > 0 && !Expect(","))
+					return false;
+				if (!ParseComparison())
+					return false;
+			}
+			return Expect(")") && Emit(functions[i].op);
+		}
+		return Fail("unknown function '" + name + "'");
+	}
+};
+
+
+/////////////////////////////////////////
+// Expression
+
+Expression::Expression():
+		inputCount(0)
+{
+}
+
+
+bool Expression::Compile(const std::string& src, const std::vector<std::string>& inputs,
+		const Constants& constants)
+{
+	Clear();
+	source = src;
+	inputCount = inputs.size();
+
+	ExpressionParser parser(*this, inputs, constants);
+	if (!parser.Parse()) {
+		code.clear();
+		return false;
+	}
+	assert(!code.empty());
+	return true;
+}
+
+void Expression::Clear()
+{
+	code.clear();
+	source.clear();
+	error.clear();
+	inputCount = 0;
+}
+
+
+int Expression::Arity(OpCode op)
+{
+	switch (op) {
+		case OP_CONST: case OP_INPUT:
+			return 0;
+		case OP_NEG: case OP_ABS: case OP_FLOOR: case OP_CEIL: case OP_SQRT:
+			return 1;
+		case OP_CLAMP: case OP_SELECT:
+			return 3;
+		default:
+			return 2;
+	}
+}
+
+float Expression::Apply(OpCode op, float a, float b, float c)
+{
+	switch (op) {
+		case OP_NEG: return -a;
+		case OP_ABS: return fabsf(a);
+		case OP_FLOOR: return floorf(a);
+		case OP_CEIL: return ceilf(a);
+		case OP_SQRT: return sqrtf(a);
+		case OP_ADD: return a + b;
+		case OP_SUB: return a - b;
+		case OP_MUL: return a * b;
+		case OP_DIV: return a / b;
+		case OP_MOD: return fmodf(a, b);
+		case OP_LT: return a < b;
+		case OP_LE: return a <= b;
+		case OP_GT: return a > b;
+		case OP_GE: return a >= b;
+		case OP_EQ: return a == b;
+		case OP_NE: return a != b;
+		case OP_MIN: return std::min(a, b);
+		case OP_MAX: return std::max(a, b);
+		case OP_CLAMP: return std::max(b, std::min(a, c));
+		case OP_SELECT: return a != 0 ? b : c;
+		default:
+			assert(false);
+			return 0;
+	}
+}
+
+
+float Expression::Eval(const float* inputs) const
+{
+	assert(IsValid());
+	float stack[MAX_STACK];
+	int top = 0;
+
+	for (std::vector<Op>::const_iterator it = code.begin(); it != code.end(); ++it) {
+		switch (it->code) {
+			case OP_CONST:
+				stack[top++] = it->value;
+				break;
+			case OP_INPUT:
+				stack[top++] = inputs[it->input];
+				break;
+			default: {
+				int arity = Arity(it->code);
+				top -= arity;
+				float* args = stack + top;
+				stack[top++] = Apply(it->code, args[0],
+						arity > 1 ? args[1] : 0, arity > 2 ? args[2] : 0);
+			}
+		}
+	}
+	assert(top == 1);
+	return stack[0];
+}
+
+
+/// runs each instruction over the whole batch, one column per stack slot
+void Expression::EvalBatch(const float* const* inputs, size_t n, float* out) const
+{
+	assert(IsValid());
+	if (n == 0)
+		return;
+
+	std::vector<float> stack(MAX_STACK * n);
+	int top = 0;
+
+	for (std::vector<Op>::const_iterator it = code.begin(); it != code.end(); ++it) {
+		switch (it->code) {
+			case OP_CONST:
+				std::fill(&stack[top*n], &stack[top*n] + n, it->value);
+				++top;
+				break;
+			case OP_INPUT:
+				std::copy(inputs[it->input], inputs[it->input] + n, &stack[top*n]);
+				++top;
+				break;
+			default: {
+				int arity = Arity(it->code);
+				top -= arity;
+				float* a = &stack[top*n];
+				const float* b = arity > 1 ? a + n : a;
+				const float* c = arity > 2 ? a + 2*n : a;
+				OpCode op = it->code;
+				// results go to the first operand's column
+				switch (op) {
+					case OP_ADD: for (size_t i = 0; i < n; ++i) a[i] += b[i]; break;
+					case OP_SUB: for (size_t i = 0; i < n; ++i) a[i] -= b[i]; break;
+					case OP_MUL: for (size_t i = 0; i < n; ++i) a[i] *= b[i]; break;
+					case OP_DIV: for (size_t i = 0; i < n; ++i) a[i] /= b[i]; break;
+					default:
+						for (size_t i = 0; i < n; ++i)
+							a[i] = Apply(op, a[i], b[i], c[i]);
+				}
+				++top;
+			}
+		}
+	}
+	assert(top == 1);
+	std::copy(&stack[0], &stack[0] + n, out);
+}
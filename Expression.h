@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <string>
+#include <vector>
+
+/// arithmetic formula compiled to a flat stack bytecode
+///
+/// Values are floats; comparisons give 0 or 1. Syntax:
+///   numbers, input and constant names, ( ), unary -, * / %, + -,
+///   < <= > >= == !=, and the functions min(a,b) max(a,b) abs(x)
+///   floor(x) ceil(x) sqrt(x) clamp(x,lo,hi) if(cond,a,b)
+/// Subexpressions with only constants are folded when compiling.
+class Expression
+{
+public:
+	typedef std::map<std::string, float> Constants;
+
+	Expression();
+
+	/// inputs are given to Eval in this order
+	bool Compile(const std::string& source, const std::vector<std::string>& inputs,
+			const Constants& constants = Constants());
+	void Clear();
+
+	bool IsValid() const { return !code.empty(); }
+	const std::string& GetError() const { return error; }
+	const std::string& GetSource() const { return source; }
+	size_t InputCount() const { return inputCount; }
+
+	float Eval(const float* inputs) const;
+	/// inputs[i] is the array of n values of input i
+	void EvalBatch(const float* const* inputs, size_t n, float* out) const;
+
+protected:
+	enum OpCode {
+		OP_CONST, OP_INPUT,
+		OP_NEG, OP_ABS, OP_FLOOR, OP_CEIL, OP_SQRT,
+		OP_ADD, OP_SUB, OP_MUL, OP_DIV, OP_MOD,
+		OP_LT, OP_LE, OP_GT, OP_GE, OP_EQ, OP_NE,
+		OP_MIN, OP_MAX,
+		OP_CLAMP, OP_SELECT
+	};
+
+	struct Op {
+		OpCode code;
+		int input;
+		float value;
+		Op(OpCode c, int i = 0, float v = 0):code(c), input(i), value(v) {}
+	};
+
+	static const int MAX_STACK = 32;
+
+	std::vector<Op> code;
+	std::string source;
+	std::string error;
+	size_t inputCount;
+
+	static int Arity(OpCode op);
+	static float Apply(OpCode op, float a, float b, float c);
+
+	friend class ExpressionParser;
+};
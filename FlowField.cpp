@@ -0,0 +1,96 @@
+#include <cfloat>
+#include <functional>
+#include <queue>
+#include <utility>
+
+#include "PassabilityGrid.h"
+#include "FlowField.h"
+
+
+FlowField::FlowField():
+		grid(0)
+{
+}
+
+
+void FlowField::Compute(const PassabilityGrid& g, const std::vector<float3>& sources)
+{
+	grid = &g;
+	const int w = grid->w, h = grid->h;
+	dist.assign(w*h, FLT_MAX);
+
+	typedef std::pair<float, int> QueueItem; //<! distance, cell index
+	std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<QueueItem> > open;
+
+	// sources sit on passable ground even if their cell is marked steep
+	for (size_t i = 0; i < sources.size(); ++i) {
+		int cell = grid->CellX(sources[i].x) + grid->CellZ(sources[i].z)*w;
+		if (dist[cell] == 0)
+			continue;
+		dist[cell] = 0;
+		open.push(QueueItem(0, cell));
+	}
+
+	static const int dx[8] = { 1, -1, 0, 0, 1, 1, -1, -1 };
+	static const int dz[8] = { 0, 0, 1, -1, 1, -1, 1, -1 };
+	const float straight = (float)PassabilityGrid::CELL_SIZE;
+	const float diagonal = straight * 1.41421356f;
+
+	while (!open.empty()) {
+		QueueItem top = open.top();
+		open.pop();
+		int cell = top.second;
+		if (top.first > dist[cell])
+			continue; // stale entry
+		int x = cell % w, z = cell / w;
+
+		for (int d = 0; d < 8; ++d) {
+			int nx = x + dx[d], nz = z + dz[d];
+			if (!grid->IsPassable(nx, nz))
+				continue;
+			// diagonal moves need both sides open
+			if (d >= 4 && (!grid->IsPassable(nx, z) || !grid->IsPassable(x, nz)))
+				continue;
+			int next = nx + nz*w;
+			float nd = top.first + (d < 4 ? straight : diagonal);
+			if (nd < dist[next]) {
+				dist[next] = nd;
+				open.push(QueueItem(nd, next));
+			}
+		}
+	}
+}
+
+void FlowField::clear()
+{
+	grid = 0;
+	dist.clear();
+}
+
+
+int FlowField::ReachedCell(const float3& pos) const
+{
+	int x = grid->CellX(pos.x), z = grid->CellZ(pos.z);
+	int best = x + z*grid->w;
+	if (dist[best] != FLT_MAX)
+		return best;
+
+	for (int nz = z-1; nz <= z+1; ++nz) {
+		for (int nx = x-1; nx <= x+1; ++nx) {
+			if (!grid->InBounds(nx, nz))
+				continue;
+			int cell = nx + nz*grid->w;
+			if (dist[cell] < dist[best])
+				best = cell;
+		}
+	}
+	return best;
+}
+
+float FlowField::Distance(const float3& pos) const
+{
+	if (!grid)
+		return -1;
+	float d = dist[ReachedCell(pos)];
+	return d == FLT_MAX ? -1 : d;
+}
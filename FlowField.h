@@ -0,0 +1,33 @@
+#pragma once
+
+#include <vector>
+
+#include "float3.h"
+
+class PassabilityGrid;
+
+/// distance from every cell to the nearest of a set of sources
+///
+/// Compute runs one multi-source Dijkstra over the passable cells of a
+/// PassabilityGrid (8-connected, no cutting corners), so looking up the
+/// distance from any point to its nearest source is a single read.
+class FlowField
+{
+public:
+	FlowField();
+
+	void Compute(const PassabilityGrid& grid, const std::vector<float3>& sources);
+	void clear();
+
+	bool IsValid() const { return grid != 0; }
+	/// path distance in elmos to the nearest source, -1 if unreachable
+	float Distance(const float3& pos) const;
+
+protected:
+	const PassabilityGrid* grid;
+
+	/// cell of pos, or its closest reached neighbour if pos is on a blocked cell
+	int ReachedCell(const float3& pos) const;
+
+	std::vector<float> dist;
+};
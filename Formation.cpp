@@ -0,0 +1,174 @@
+#include <cassert>
+#include <cmath>
+#include <algorithm>
+#include <limits>
+
+#include "Formation.h"
+
+
+Formation::Formation():
+		spacing(48), aspectRatio(4), maxExact(100)
+{
+}
+
+
+int Formation::RowLength(int count) const
+{
+	// perRow ** 2 / aspect ratio = total units
+	return std::max(1, (int)std::ceil(std::sqrt(count*aspectRatio)));
+}
+
+float3 Formation::SlotPos(int i, int perRow, const float3& front,
+		const float3& dir, const float3& rightdir) const
+{
+	int rowPos = i%perRow;
+	int x;
+	if (rowPos & 1) { // odd variant
+		x = -rowPos / 2 - 1;
+	} else { // even
+		x = rowPos / 2;
+	}
+	int y = i/perRow;
+	return dir*y*-spacing + rightdir*x*spacing + front;
+}
+
+
+void Formation::Assign(const std::vector<float3>& units, const std::vector<float3>& slots,
+		std::vector<int>& slotOf) const
+{
+	const int n = units.size();
+	const int m = slots.size();
+	slotOf.assign(n, -1);
+	if (n == 0 || m == 0)
+		return;
+
+	// the solvers want no more rows than columns
+	const bool transposed = n > m;
+	const int rows = transposed ? m : n;
+	const int cols = transposed ? n : m;
+	std::vector<float> cost(rows*cols);
+	for (int i = 0; i < n; ++i) {
+		for (int j = 0; j < m; ++j) {
+			float d = units[i].distance2D(slots[j]);
+			if (transposed)
+				cost[j*cols + i] = d;
+			else
+				cost[i*cols + j] = d;
+		}
+	}
+
+	std::vector<int> colOf;
+	if (rows <= maxExact)
+		AssignOptimal(cost, rows, cols, colOf);
+	else
+		AssignGreedy(cost, rows, cols, colOf);
+
+	for (int r = 0; r < rows; ++r) {
+		if (colOf[r] < 0)
+			continue;
+		if (transposed)
+			slotOf[colOf[r]] = r;
+		else
+			slotOf[r] = colOf[r];
+	}
+}
+
+
+/// Hungarian method with row and column potentials, adding one row at a
+/// time along the shortest augmenting path
+void Formation::AssignOptimal(const std::vector<float>& cost, int rows, int cols,
+		std::vector<int>& colOf)
+{
+	assert(rows <= cols);
+	const double INF = std::numeric_limits<double>::max();
+
+	// 1-based, column 0 is a virtual start for the augmenting path
+	std::vector<double> u(rows+1, 0), v(cols+1, 0), minv(cols+1);
+	std::vector<int> rowOf(cols+1, 0), way(cols+1, 0);
+	std::vector<char> used(cols+1);
+
+	for (int i = 1; i <= rows; ++i) {
+		rowOf[0] = i;
+		int j0 = 0;
+		std::fill(minv.begin(), minv.end(), INF);
+		std::fill(used.begin(), used.end(), 0);
+		do {
+			used[j0] = 1;
+			const int i0 = rowOf[j0];
+			const float* row = &cost[(i0-1)*cols];
+			double delta = INF;
+			int j1 = 0;
+			for (int j = 1; j <= cols; ++j) {
+				if (used[j])
+					continue;
+				double cur = row[j-1] - u[i0] - v[j];
+				if (cur < minv[j]) {
+					minv[j] = cur;
+					way[j] = j0;
+				}
+				if (minv[j] < delta) {
+					delta = minv[j];
+					j1 = j;
+				}
+			}
+			for (int j = 0; j <= cols; ++j) {
+				if (used[j]) {
+					u[rowOf[j]] += delta;
+					v[j] -= delta;
+				} else {
+					minv[j] -= delta;
+				}
+			}
+			j0 = j1;
+		} while (rowOf[j0] != 0);
+
+		// flip the path
+		do {
+			int j1 = way[j0];
+			rowOf[j0] = rowOf[j1];
+			j0 = j1;
+		} while (j0);
+	}
+
+	colOf.assign(rows, -1);
+	for (int j = 1; j <= cols; ++j) {
+		if (rowOf[j])
+			colOf[rowOf[j]-1] = j-1;
+	}
+}
+
+
+namespace {
+struct Pair {
+	float cost;
+	int row, col;
+	bool operator<(const Pair& o) const { return cost < o.cost; }
+};
+}
+
+void Formation::AssignGreedy(const std::vector<float>& cost, int rows, int cols,
+		std::vector<int>& colOf)
+{
+	std::vector<Pair> pairs(rows*cols);
+	for (int r = 0; r < rows; ++r) {
+		for (int c = 0; c < cols; ++c) {
+			Pair& p = pairs[r*cols + c];
+			p.cost = cost[r*cols + c];
+			p.row = r;
+			p.col = c;
+		}
+	}
+	std::sort(pairs.begin(), pairs.end());
+
+	colOf.assign(rows, -1);
+	std::vector<char> colUsed(cols, 0);
+	int left = rows;
+	for (size_t k = 0; k < pairs.size() && left > 0; ++k) {
+		const Pair& p = pairs[k];
+		if (colOf[p.row] >= 0 || colUsed[p.col])
+			continue;
+		colOf[p.row] = p.col;
+		colUsed[p.col] = 1;
+		--left;
+	}
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <vector>
+
+#include "float3.h"
+
+/// formation slots and unit to slot assignment
+///
+/// Slots are laid out in rows behind the front point, each row filled
+/// from the middle outwards:
+///   front
+/// 3 1 0 2 4
+/// 8 6 5 7 9
+/// Units are matched to slots minimizing the sum of 2D travel distances,
+/// which also means no two units' straight paths cross. Groups up to
+/// maxExact units are solved exactly (Hungarian method, O(n^3)), larger
+/// ones greedily by taking the shortest remaining unit-slot pair.
+class Formation
+{
+public:
+	Formation();
+
+	float spacing; //<! elmos between slots
+	float aspectRatio; //<! row length / row count
+	int maxExact;
+
+	int RowLength(int count) const;
+	/// position of slot i, dir points from the front to the back
+	float3 SlotPos(int i, int perRow, const float3& front,
+			const float3& dir, const float3& rightdir) const;
+
+	/// slotOf[i] is the slot index of unit i, -1 if it got none
+	void Assign(const std::vector<float3>& units, const std::vector<float3>& slots,
+			std::vector<int>& slotOf) const;
+
+protected:
+	/// cost is rows x cols, row major, rows <= cols
+	static void AssignOptimal(const std::vector<float>& cost, int rows, int cols,
+			std::vector<int>& colOf);
+	static void AssignGreedy(const std::vector<float>& cost, int rows, int cols,
+			std::vector<int>& colOf);
+};
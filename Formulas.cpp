@@ -0,0 +1,134 @@
+#include <fstream>
+#include <boost/foreach.hpp>
+#include <boost/filesystem.hpp>
+
+#include "json_spirit/json_spirit.h"
+
+#include "ExternalAI/IAICallback.h"
+
+#include "Log.h"
+#include "PythonScripting.h"
+#include "Formulas.h"
+
+
+Formulas::Formulas():
+		python(0)
+{
+}
+
+
+/// compiles a formula and logs why it's unusable
+static void CompileFormula(Expression& expr, const json_spirit::Object& root,
+		const char* name, const char* inputNames)
+{
+	expr.Clear();
+
+	const json_spirit::Value* source = 0;
+	BOOST_FOREACH(const json_spirit::Pair& p, root) {
+		if (p.name_ == name)
+			source = &p.value_;
+	}
+	if (!source)
+		return;
+	if (source->type() != json_spirit::str_type) {
+		LOG_ERROR << "formula " << name << " is not a string" << std::endl;
+		return;
+	}
+
+	std::vector<std::string> inputs;
+	std::string names(inputNames);
+	size_t start = 0, end;
+	do {
+		end = names.find(',', start);
+		inputs.push_back(names.substr(start, end - start));
+		start = end + 1;
+	} while (end != std::string::npos);
+
+	Expression::Constants constants;
+	constants["GAME_SPEED"] = GAME_SPEED;
+	constants["SQUARE_SIZE"] = SQUARE_SIZE;
+	constants["MAX_UNITS"] = MAX_UNITS;
+
+	if (expr.Compile(source->get_str(), inputs, constants)) {
+		LOG_INFO << "formula " << name << "(" << inputNames << ") = "
+			<< expr.GetSource() << std::endl;
+	} else {
+		LOG_ERROR << "formula " << name << ": " << expr.GetError()
+			<< " in \"" << source->get_str() << "\"" << std::endl;
+	}
+}
+
+bool Formulas::Load(const std::string& fileName, PythonScripting* py)
+{
+	python = py;
+
+	json_spirit::Object root;
+	if (boost::filesystem::is_regular_file(boost::filesystem::path(fileName))) {
+		std::ifstream is(fileName.c_str());
+		json_spirit::Value value;
+		if (json_spirit::read(is, value) && value.type() == json_spirit::obj_type) {
+			root = value.get_obj();
+		} else {
+			LOG_ERROR << "can't parse " << fileName << std::endl;
+		}
+	}
+
+	CompileFormula(wantedConstructors, root, "wanted_constructors", "geospots,width,height");
+	CompileFormula(builderRetreatTimeout, root, "builder_retreat_timeout", "frame");
+	CompileFormula(buildSpotPriority, root, "build_spot_priority", "distance,influence,width,height");
+	return !root.empty();
+}
+
+
+void Formulas::WriteDefaultJSONConfig(const std::string& fileName)
+{
+	json_spirit::Object root;
+	root.push_back(json_spirit::Pair("wanted_constructors",
+			"max(floor(geospots/4), 1)"));
+	root.push_back(json_spirit::Pair("builder_retreat_timeout",
+			"frame + 10*GAME_SPEED"));
+	root.push_back(json_spirit::Pair("build_spot_priority",
+			"influence - distance/(width+height)*10"));
+
+	std::ofstream os(fileName.c_str());
+	json_spirit::write_formatted(root, os);
+}
+
+
+int Formulas::GetWantedConstructors(int geospots, int width, int height)
+{
+	if (!wantedConstructors.IsValid())
+		return python->GetWantedConstructors(geospots, width, height);
+	float inputs[] = { (float)geospots, (float)width, (float)height };
+	return (int)wantedConstructors.Eval(inputs);
+}
+
+int Formulas::GetBuilderRetreatTimeout(int frameNum)
+{
+	if (!builderRetreatTimeout.IsValid())
+		return python->GetBuilderRetreatTimeout(frameNum);
+	float inputs[] = { (float)frameNum };
+	return (int)builderRetreatTimeout.Eval(inputs);
+}
+
+bool Formulas::GetBuildSpotPriorities(const std::vector<float>& distances,
+		const std::vector<int>& influences, int width, int height,
+		std::vector<int>& priorities)
+{
+	if (!buildSpotPriority.IsValid())
+		return python->GetBuildSpotPriorities(distances, influences, width, height, priorities);
+
+	size_t n = distances.size();
+	priorities.resize(n);
+	if (n == 0)
+		return true;
+
+	std::vector<float> influenceColumn(influences.begin(), influences.end());
+	std::vector<float> widthColumn(n, (float)width), heightColumn(n, (float)height);
+	std::vector<float> result(n);
+	const float* inputs[] = { &distances[0], &influenceColumn[0], &widthColumn[0], &heightColumn[0] };
+	buildSpotPriority.EvalBatch(inputs, n, &result[0]);
+	for (size_t i = 0; i < n; ++i)
+		priorities[i] = (int)result[i];
+	return true;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "Expression.h"
+
+class PythonScripting;
+
+/// tunable formulas evaluated natively, read from formulas.json
+///
+/// The file maps formula names to expressions (see Expression for the
+/// syntax). A formula which is missing or doesn't compile falls back to
+/// the matching hook in init.py, and to the built-in default after that.
+class Formulas
+{
+public:
+	Formulas();
+
+	bool Load(const std::string& fileName, PythonScripting* python);
+	static void WriteDefaultJSONConfig(const std::string& fileName);
+
+	/// inputs: geospots, width, height
+	int GetWantedConstructors(int geospots, int width, int height);
+	/// inputs: frame
+	int GetBuilderRetreatTimeout(int frameNum);
+	/// inputs: distance, influence, width, height; returns false if neither
+	/// the formula nor the python hook is usable
+	bool GetBuildSpotPriorities(const std::vector<float>& distances,
+			const std::vector<int>& influences, int width, int height,
+			std::vector<int>& priorities);
+
+protected:
+	PythonScripting* python;
+
+	Expression wantedConstructors;
+	Expression builderRetreatTimeout;
+	Expression buildSpotPriority;
+};
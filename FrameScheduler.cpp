@@ -0,0 +1,190 @@
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <boost/foreach.hpp>
+
+#include "Log.h"
+#include "Clock.h"
+#include "Profiler.h"
+#include "FrameScheduler.h"
+
+
+FrameScheduler::FrameScheduler():
+		load(LOAD_HORIZON, 0.f)
+{
+	budget = 5000;
+	criticalPriority = 10;
+	maxDeferFrames = 5;
+	lastTaskId = 0;
+	lastFrame = -1;
+}
+
+FrameScheduler::~FrameScheduler()
+{
+}
+
+
+int FrameScheduler::AddTask(const std::string& name, int period, int phase, int priority,
+		int costEstimate, const FrameScheduler::TaskFunc& func)
+{
+	assert(period > 0);
+
+	Task t;
+	t.id = ++lastTaskId;
+	t.name = name;
+	t.period = period;
+	t.priority = priority;
+	t.avgCost = (float)costEstimate;
+	t.deferred = 0;
+	t.func = func;
+	t.zone = Profiler::RegisterZone(name);
+	t.runs = 0;
+	t.deferrals = 0;
+	t.totalCost = 0;
+	t.maxCost = 0;
+
+	if (phase == ANY_PHASE)
+		t.phase = PickPhase(period, t.avgCost);
+	else
+		t.phase = phase % period;
+	t.nextFrame = NextRunFrame(lastFrame+1, period, t.phase);
+
+	AddLoad(t, 1);
+	tasks.insert(TaskMap::value_type(t.id, t));
+
+	LOG_INFO << "scheduler: task " << name << " every " << period
+		<< " frames at phase " << t.phase << std::endl;
+	return t.id;
+}
+
+void FrameScheduler::RemoveTask(int taskId)
+{
+	TaskMap::iterator it = tasks.find(taskId);
+	if (it == tasks.end())
+		return;
+	AddLoad(it->second, -1);
+	tasks.erase(it);
+}
+
+
+struct TaskPriorityGreater {
+	const std::map<int, int>& prio;
+	TaskPriorityGreater(const std::map<int, int>& p):prio(p) {}
+	bool operator()(int a, int b) const {
+		int pa = prio.find(a)->second, pb = prio.find(b)->second;
+		return pa > pb || (pa == pb && a < b);
+	}
+};
+
+void FrameScheduler::Run(int frame)
+{
+	lastFrame = frame;
+
+	std::vector<int> due;
+	std::map<int, int> prio;
+	for (TaskMap::iterator it = tasks.begin(); it != tasks.end(); ++it) {
+		if (it->second.nextFrame <= frame) {
+			due.push_back(it->first);
+			prio[it->first] = it->second.priority;
+		}
+	}
+	if (due.empty())
+		return;
+	std::sort(due.begin(), due.end(), TaskPriorityGreater(prio));
+
+	boost::int64_t spent = 0;
+	BOOST_FOREACH(int taskId, due) {
+		// tasks may add or remove tasks, look them up every time
+		TaskMap::iterator it = tasks.find(taskId);
+		if (it == tasks.end())
+			continue;
+		Task& t = it->second;
+
+		if (t.priority < criticalPriority && t.deferred < maxDeferFrames
+				&& spent + t.avgCost > budget) {
+			++t.deferred;
+			++t.deferrals;
+			continue;
+		}
+
+		boost::int64_t start = GetMicroseconds();
+		{
+			ProfileZone zone(t.zone);
+			t.func(frame);
+		}
+		boost::int64_t cost = GetMicroseconds() - start;
+		spent += cost;
+
+		// t may be gone if the task removed itself
+		it = tasks.find(taskId);
+		if (it == tasks.end())
+			continue;
+		Task& done = it->second;
+		AddLoad(done, -1);
+		done.avgCost = 0.8f*done.avgCost + 0.2f*cost;
+		AddLoad(done, 1);
+		++done.runs;
+		done.totalCost += cost;
+		done.maxCost = std::max(done.maxCost, cost);
+		done.deferred = 0;
+		// stay on the phase grid even after being deferred
+		done.nextFrame = NextRunFrame(frame+1, done.period, done.phase);
+	}
+}
+
+
+void FrameScheduler::LogStats()
+{
+	LOG_INFO << "scheduler stats (budget " << budget << "us):" << std::endl;
+	for (TaskMap::iterator it = tasks.begin(); it != tasks.end(); ++it) {
+		const Task& t = it->second;
+		LOG_INFO << "  " << t.name << ": runs " << t.runs
+			<< " mean " << (t.runs ? t.totalCost / t.runs : 0) << "us"
+			<< " max " << t.maxCost << "us"
+			<< " deferred " << t.deferrals << std::endl;
+	}
+}
+
+
+/// pick the phase on which the task's runs push the fewest frames over budget
+///
+/// Expensive tasks end up on phases whose frames still have room for them,
+/// away from each other; cheap ones, which fit anywhere, go on the phase
+/// with the lowest peak load.
+int FrameScheduler::PickPhase(int period, float cost)
+{
+	if (LOAD_HORIZON % period != 0)
+		return lastTaskId % period;
+
+	int best = 0;
+	float bestOverrun = FLT_MAX;
+	float bestLoad = FLT_MAX;
+	for (int phase = 0; phase < period; ++phase) {
+		float overrun = 0;
+		float worst = 0;
+		for (int f = phase; f < LOAD_HORIZON; f += period) {
+			overrun += std::max(0.f, load[f] + cost - budget);
+			worst = std::max(worst, load[f]);
+		}
+		if (overrun < bestOverrun || (overrun == bestOverrun && worst < bestLoad)) {
+			bestOverrun = overrun;
+			bestLoad = worst;
+			best = phase;
+		}
+	}
+	return best;
+}
+
+void FrameScheduler::AddLoad(const Task& t, float sign)
+{
+	if (LOAD_HORIZON % t.period != 0)
+		return;
+	for (int f = t.phase; f < LOAD_HORIZON; f += t.period)
+		load[f] += sign*t.avgCost;
+}
+
+int FrameScheduler::NextRunFrame(int frame, int period, int phase)
+{
+	int offset = ((phase - frame) % period + period) % period;
+	return frame + offset;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+#include <boost/function.hpp>
+#include <boost/cstdint.hpp>
+
+/// runs periodic tasks spread over frames under a per-frame time budget
+///
+/// A task runs every period frames at its phase (frame % period == phase).
+/// Tasks registered with ANY_PHASE are put on the phase where their cost
+/// overruns the budget least. When a frame runs over budget, due tasks below
+/// criticalPriority are deferred to the next frame, at most maxDeferFrames
+/// times in a row.
+class FrameScheduler
+{
+public:
+	FrameScheduler();
+	~FrameScheduler();
+
+	typedef boost::function<void (int)> TaskFunc; //<! called with frame number
+
+	static const int ANY_PHASE = -1;
+
+	int budget; //<! microseconds per frame
+	int criticalPriority; //<! tasks with priority >= this are never deferred
+	int maxDeferFrames;
+
+	/// cost estimate is in microseconds, it's refined by measurements
+	int AddTask(const std::string& name, int period, int phase, int priority,
+			int costEstimate, const TaskFunc& func);
+	void RemoveTask(int taskId);
+
+	void Run(int frame);
+
+	void LogStats();
+
+protected:
+	struct Task {
+		int id;
+		std::string name;
+		int period;
+		int phase;
+		int priority;
+		float avgCost;
+		int nextFrame;
+		int deferred;
+		TaskFunc func;
+		int zone; //<! profiler zone
+
+		// stats
+		int runs;
+		int deferrals;
+		boost::int64_t totalCost;
+		boost::int64_t maxCost;
+	};
+
+	typedef std::map<int, Task> TaskMap;
+	TaskMap tasks;
+	int lastTaskId;
+	int lastFrame;
+
+	static const int LOAD_HORIZON = 300; //<! frames covered by the load table
+	std::vector<float> load; //<! estimated cost per frame of the horizon
+
+	int PickPhase(int period, float cost);
+	void AddLoad(const Task& t, float sign);
+	static int NextRunFrame(int frame, int period, int phase);
+};
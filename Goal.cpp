@@ -1,20 +1,123 @@
 #include <iostream>
+#include <algorithm>
 #include <boost/thread.hpp>
+#include <boost/foreach.hpp>
 
 #include "Goal.h"
 
-GoalSet g_goals;
-int Goal::global_id = 0;
 
+GoalRegistry::GoalRegistry():
+		lastId(0)
+{
+}
+
+GoalRegistry::~GoalRegistry()
+{
+}
+
+
+int GoalRegistry::CreateGoal(int priority, Type type)
+{
+	int id;
+	{
+		boost::mutex::scoped_lock lock(idMutex);
+		id = ++lastId;
+	}
+	Goal* g = new Goal(this, id, priority, type);
+
+	Shard& shard = ShardFor(id);
+	boost::mutex::scoped_lock lock(shard.mutex);
+	shard.goals.insert(id, g);
+	return id;
+}
+
+
+size_t GoalRegistry::size()
+{
+	size_t total = 0;
+	for (int i = 0; i<SHARDS; ++i) {
+		boost::mutex::scoped_lock lock(shards[i].mutex);
+		total += shards[i].goals.size();
+	}
+	return total;
+}
+
+
+void GoalRegistry::GetPriorities(const std::vector<int>& ids, std::vector<int>& priorities)
+{
+	priorities.resize(ids.size());
+	// always in shard order, no other code holds two shard locks
+	for (int i = 0; i < SHARDS; ++i)
+		shards[i].mutex.lock();
+	for (size_t i = 0; i < ids.size(); ++i) {
+		GoalSet& goals = ShardFor(ids[i]).goals;
+		GoalSet::iterator it = goals.find(ids[i]);
+		priorities[i] = it == goals.end() ? INT_MAX : it->second->priority;
+	}
+	for (int i = SHARDS - 1; i >= 0; --i)
+		shards[i].mutex.unlock();
+}
+
+namespace {
+struct PairFirstLess {
+	bool operator()(const std::pair<int, int>& a, const std::pair<int, int>& b) const
+	{
+		return a.first < b.first;
+	}
+};
+}
+
+void GoalRegistry::SortByPriority(std::vector<int>& ids)
+{
+	std::vector<int> priorities;
+	GetPriorities(ids, priorities);
+
+	std::vector<std::pair<int, int> > keyed(ids.size());
+	for (size_t i = 0; i < ids.size(); ++i)
+		keyed[i] = std::make_pair(priorities[i], ids[i]);
+	std::stable_sort(keyed.begin(), keyed.end(), PairFirstLess());
+	for (size_t i = 0; i < ids.size(); ++i)
+		ids[i] = keyed[i].second;
+}
 
-int Goal::CreateGoal(int priority, Type type)
+int GoalRegistry::TopPriorityIndex(const std::vector<int>& ids)
 {
-	static boost::mutex mutex;
+	if (ids.empty())
+		return -1;
+	std::vector<int> priorities;
+	GetPriorities(ids, priorities);
+	return std::max_element(priorities.begin(), priorities.end()) - priorities.begin();
+}
+
+
+void GoalRegistry::ScheduleTimeout(Goal* g)
+{
+	assert(g);
+	if (g->timeoutFrame >= 0) {
+		boost::mutex::scoped_lock lock(timeoutMutex);
+		timeouts.Schedule(g->id, g->timeoutFrame);
+	}
+}
+
+void GoalRegistry::ExpireGoals(int frame)
+{
+	std::vector<int> expired;
 	{
-		boost::mutex::scoped_lock(mutex);
-		++global_id;
+		boost::mutex::scoped_lock lock(timeoutMutex);
+		timeouts.Advance(frame, expired);
+	}
+
+	BOOST_FOREACH(int gid, expired) {
+		Goal* g = GetGoal(gid);
+		// goal may have been removed or finished in the meantime
+		if (!g || g->is_finished() || g->timeoutFrame < 0)
+			continue;
+		// timeout moved after scheduling
+		if (g->timeoutFrame > frame) {
+			ScheduleTimeout(g);
+			continue;
+		}
+		LOG_INFO << "goal " << gid << " timed out" << std::endl;
+		RemoveGoal(g);
 	}
-	Goal* g = new Goal(priority, type);
-	g_goals.insert(g->id, g);
-	return g->id;
 }
@@ -1,18 +1,20 @@
 #pragma once
 
 #include <cassert>
+#include <climits>
 #include <vector>
 #include <string>
 #include <queue>
 #include <iostream>
 #include <boost/ptr_container/ptr_unordered_map.hpp>
 #include <boost/signal.hpp>
-#include <boost/variant.hpp>
 #include <boost/thread.hpp>
 
 #include "float3.h"
 
 #include "Log.h"
+#include "GoalParam.h"
+#include "TimingWheel.h"
 
 enum Type {
 	ATTACK,
@@ -28,30 +30,15 @@ enum Type {
 };
 
 
-// needed for boost::variant here
-inline std::ostream &operator <<(std::ostream& os, float3 f)
-{
-	os << f.x << " " << f.y << " " << f.z;
-	return os;
-}
-
-
+class GoalRegistry;
 
 class Goal
 {
 public:
-	Goal(void) {
-		id = global_id;
-		flags = 0;
-		priority = 0;
-		type = NO_TYPE;
-		parent = -1;
-		timeoutFrame = -1;
-	}
-
-	Goal(int priority, Type type)
+	Goal(GoalRegistry* registry, int id, int priority, Type type)
 	{
-		id = global_id;
+		this->registry = registry;
+		this->id = id;
 		flags = 0;
 		this->priority = priority;
 		this->type = type;
@@ -61,14 +48,15 @@ public:
 
 	~Goal() {};
 
-	typedef boost::variant<int, float3, std::string> param_variant;
-	typedef std::vector<param_variant> param_vector;
+	typedef GoalParam param_type;
+	typedef GoalParams param_vector;
 	
 	typedef boost::signal<void (Goal&)> on_complete_sig;
 	typedef boost::signal<void (Goal&)> on_abort_sig;
 	typedef boost::signal<void (Goal&)> on_start_sig;
 	typedef boost::signal<void (Goal&)> on_suspend_sig;
 	typedef boost::signal<void (Goal&)> on_continue_sig;
+	typedef boost::signal<void (Goal&)> on_priority_change_sig;
 	typedef boost::signals::connection connection;
 
 	static const int FINISHED = 0x0001;
@@ -78,10 +66,9 @@ public:
 	static const int SUSPENDED = 0x0010;
 	static const int TO_CONTINUE = 0x0020;
 
-	static int global_id;
-
+	GoalRegistry* registry; //<! owner of this goal
 	int id;
-	int priority;
+	int priority; //<! change with set_priority, goal indexes key on it
 	int flags;
 	int parent; //<! parent goal id
 	int timeoutFrame; //<! -1 == never timeout
@@ -94,6 +81,7 @@ public:
 	on_start_sig onStart;
 	on_suspend_sig onSuspend;
 	on_continue_sig onContinue;
+	on_priority_change_sig onPriorityChange;
 
 	bool operator<(const Goal& o) { return id < o.id; }
 	bool operator==(const Goal& o) { return id == o.id; }
@@ -123,6 +111,11 @@ public:
 		return onSuspend.connect(f);
 	}
 
+	connection OnPriorityChange(on_priority_change_sig::slot_function_type f)
+	{
+		return onPriorityChange.connect(f);
+	}
+
 	bool is_finished() { return (bool)(flags & FINISHED); }
 	bool is_executing() { return (bool)(flags & EXECUTING); }
 	bool is_suspended() { return (bool)(flags & SUSPENDED); }
@@ -131,93 +124,128 @@ public:
 	void start() {
 		assert(!is_finished());
 		flags = EXECUTING;
-		ailog->info() << "starting goal " << id << " (parent " << parent << ")" << std::endl;
+		LOG_INFO << "starting goal " << id << " (parent " << parent << ")" << std::endl;
 		onStart(*this);
 	}
 	void suspend() {
 		assert(!is_finished());
 		flags = SUSPENDED;
-		ailog->info() << "suspending goal " << id << " (parent " << parent << ")" << std::endl;
+		LOG_INFO << "suspending goal " << id << " (parent " << parent << ")" << std::endl;
 		onSuspend(*this);
 	}
 	void continue_() {
 		assert(!is_finished());
 		flags = TO_CONTINUE;
-		ailog->info() << "continuing goal " << id << " (parent " << parent << ")" << std::endl;
+		LOG_INFO << "continuing goal " << id << " (parent " << parent << ")" << std::endl;
 		onContinue(*this);
 	}
 	void complete() {
 		assert(!is_finished());
 		flags = FINISHED | COMPLETED;
-		ailog->info() << "completing goal " << id << " (parent " << parent << ")" << std::endl;
+		LOG_INFO << "completing goal " << id << " (parent " << parent << ")" << std::endl;
 		onComplete(*this);
 	}
 	void abort() {
 		assert(!is_finished());
 		flags = FINISHED | ABORTED;
-		ailog->info() << "aborting goal " << id << " (parent " << parent << ")" << std::endl;
+		LOG_INFO << "aborting goal " << id << " (parent " << parent << ")" << std::endl;
 		onAbort(*this);
 	}
 
+	void set_priority(int p) {
+		if (p == priority)
+			return;
+		priority = p;
+		onPriorityChange(*this);
+	}
+
 	void do_continue() {
 		assert(is_restarted());
 		flags = EXECUTING;
-		ailog->info() << "goal " << id << " reprocessed after suspend" << std::endl;
+		LOG_INFO << "goal " << id << " reprocessed after suspend" << std::endl;
 	}
-
-	static int CreateGoal(int priority, Type type);
-
-	static Goal* GetGoal(int id);
-	static void RemoveGoal(Goal* g);
 };
 
 typedef boost::ptr_unordered_map<int, Goal> GoalSet;
 
-extern GoalSet g_goals;
 
-class goal_priority_less : std::binary_function<int, int, bool> {
+/// goal storage of a single AI instance
+///
+/// Goals are spread over SHARDS maps by id, each guarded by its own lock,
+/// and ids come from a locked counter, so creating and looking up goals
+/// is safe from any thread. Removal and goal events still belong to the
+/// engine thread: a Goal* stays valid only until someone removes it.
+class GoalRegistry
+{
 public:
-	bool operator()(int a, int b) const
-	{
-		GoalSet::iterator it1 = g_goals.find(a);
-		if (it1 == g_goals.end())
-			return false;
-		GoalSet::iterator it2 = g_goals.find(b);
-		if (it2 == g_goals.end())
-			return true;
-		const Goal* aa = it1->second;
-		const Goal* bb = it2->second;
-		return aa->priority < bb->priority;
-	}
+	GoalRegistry();
+	~GoalRegistry();
+
+	static const int SHARDS = 16;
+
+	int CreateGoal(int priority, Type type);
+	Goal* GetGoal(int id);
+	void RemoveGoal(Goal* g);
+
+	/// sort ids by ascending goal priority, missing goals go last; equal
+	/// priorities keep their order
+	void SortByPriority(std::vector<int>& ids);
+	/// index of the first goal with the highest priority, -1 if ids is empty
+	int TopPriorityIndex(const std::vector<int>& ids);
+
+	/// register goal's timeoutFrame in the timeout wheel
+	void ScheduleTimeout(Goal* g);
+	/// remove goals whose timeoutFrame has passed
+	void ExpireGoals(int frame);
+
+	size_t size();
+
+protected:
+	struct Shard {
+		boost::mutex mutex;
+		GoalSet goals;
+	};
+
+	Shard shards[SHARDS];
+	boost::mutex idMutex;
+	int lastId;
+
+	boost::mutex timeoutMutex;
+	TimingWheel timeouts;
+
+	Shard& ShardFor(int id) { return shards[id & (SHARDS-1)]; }
+	/// priorities of ids read with all shards locked once, INT_MAX if missing
+	void GetPriorities(const std::vector<int>& ids, std::vector<int>& priorities);
 };
 
 
-typedef std::priority_queue<int, std::vector<int>, goal_priority_less> GoalQueue;
 typedef std::vector<int> GoalStack;
 
-extern boost::mutex _global_goal_mutex;
-
-inline Goal* Goal::GetGoal(int id)
+inline Goal* GoalRegistry::GetGoal(int id)
 {
-	boost::mutex::scoped_lock(_global_goal_mutex);
+	Shard& shard = ShardFor(id);
+	boost::mutex::scoped_lock lock(shard.mutex);
 
-	GoalSet::iterator it = g_goals.find(id);
-	if (it == g_goals.end())
+	GoalSet::iterator it = shard.goals.find(id);
+	if (it == shard.goals.end())
 		return 0;
 	return it->second;
 }
 
-inline void Goal::RemoveGoal(Goal* g)
+inline void GoalRegistry::RemoveGoal(Goal* g)
 {
 	assert(g);
+	assert(g->registry == this);
+	// events may look up other goals, don't hold the lock here
 	if (!g->is_finished())
 		g->abort();
 
-	boost::mutex::scoped_lock(_global_goal_mutex);
+	Shard& shard = ShardFor(g->id);
+	boost::mutex::scoped_lock lock(shard.mutex);
 
-	GoalSet::iterator it = g_goals.find(g->id);
-	if (it != g_goals.end()) {
-		g_goals.release(it);
+	GoalSet::iterator it = shard.goals.find(g->id);
+	if (it != shard.goals.end()) {
+		shard.goals.release(it);
 	}
 }
 
@@ -227,45 +255,48 @@ inline void Goal::RemoveGoal(Goal* g)
 
 
 struct AbortGoal : public std::unary_function<Goal&, void> {
+	GoalRegistry* registry;
 	int goalId;
-	AbortGoal(Goal& s):goalId(s.id) {}
+	AbortGoal(Goal& s):registry(s.registry), goalId(s.id) {}
 	void operator()(Goal& other) {
-		Goal* self = Goal::GetGoal(goalId);
+		Goal* self = registry->GetGoal(goalId);
 		if (!self) {
-			ailog->error() << "AbortGoal: goal not found: " << goalId << std::endl;
+			LOG_ERROR << "AbortGoal: goal not found: " << goalId << std::endl;
 			return;
 		}
-		ailog->info() << "AbortGoal(" << self->id << ")" << std::endl;
+		LOG_INFO << "AbortGoal(" << self->id << ")" << std::endl;
 		if (!self->is_finished())
 			self->abort();
 	}
 };
 
 struct CompleteGoal : public std::unary_function<Goal&, void> {
+	GoalRegistry* registry;
 	int goalId;
-	CompleteGoal(Goal& s):goalId(s.id) {}
+	CompleteGoal(Goal& s):registry(s.registry), goalId(s.id) {}
 	void operator()(Goal& other) {
-		Goal* self = Goal::GetGoal(goalId);
+		Goal* self = registry->GetGoal(goalId);
 		if (!self) {
-			ailog->error() << "CompleteGoal: goal not found: " << goalId << std::endl;
+			LOG_ERROR << "CompleteGoal: goal not found: " << goalId << std::endl;
 			return;
 		}
-		ailog->info() << "CompleteGoal(" << self->id << ")" << std::endl;
+		LOG_INFO << "CompleteGoal(" << self->id << ")" << std::endl;
 		if (!self->is_finished())
 			self->complete();
 	}
 };
 
 struct StartGoal : public std::unary_function<Goal&, void> {
+	GoalRegistry* registry;
 	int goalId;
-	StartGoal(Goal& s):goalId(s.id) {}
+	StartGoal(Goal& s):registry(s.registry), goalId(s.id) {}
 	void operator()(Goal& other) {
-		Goal* self = Goal::GetGoal(goalId);
+		Goal* self = registry->GetGoal(goalId);
 		if (!self) {
-			ailog->error() << "StartGoal: goal not found: " << goalId << std::endl;
+			LOG_ERROR << "StartGoal: goal not found: " << goalId << std::endl;
 			return;
 		}
-		ailog->info() << "StartGoal(" << self->id << ")" << std::endl;
+		LOG_INFO << "StartGoal(" << self->id << ")" << std::endl;
 		if (!self->is_finished())
 			self->start();
 	}
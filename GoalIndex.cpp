@@ -0,0 +1,112 @@
+#include <algorithm>
+
+#include "GoalIndex.h"
+
+
+void GoalIndex::Insert(Goal& g)
+{
+	if (entries.find(g.id) != entries.end())
+		return;
+
+	Entry e;
+	e.type = g.type;
+	e.priority = g.priority;
+	e.hasPos = false;
+
+	byType[e.type].insert(PriorityMap::value_type(e.priority, g.id));
+
+	if (!g.params.empty() && g.params[0].is_float3()) {
+		e.hasPos = true;
+		e.pos = g.params[0].as_float3();
+		byCell.insert(CellMap::value_type(CellKey(e.type, CellCoord(e.pos.x), CellCoord(e.pos.z)), g.id));
+	}
+
+	entries.insert(EntryMap::value_type(g.id, e));
+}
+
+
+void GoalIndex::Erase(int goalId)
+{
+	EntryMap::iterator it = entries.find(goalId);
+	if (it == entries.end())
+		return;
+	const Entry& e = it->second;
+
+	std::pair<PriorityMap::iterator, PriorityMap::iterator> pr = byType[e.type].equal_range(e.priority);
+	for (PriorityMap::iterator pit = pr.first; pit != pr.second; ++pit) {
+		if (pit->second == goalId) {
+			byType[e.type].erase(pit);
+			break;
+		}
+	}
+
+	if (e.hasPos) {
+		std::pair<CellMap::iterator, CellMap::iterator> cr =
+			byCell.equal_range(CellKey(e.type, CellCoord(e.pos.x), CellCoord(e.pos.z)));
+		for (CellMap::iterator cit = cr.first; cit != cr.second; ++cit) {
+			if (cit->second == goalId) {
+				byCell.erase(cit);
+				break;
+			}
+		}
+	}
+
+	entries.erase(it);
+}
+
+
+void GoalIndex::Reprioritize(Goal& g)
+{
+	EntryMap::iterator it = entries.find(g.id);
+	if (it == entries.end() || it->second.priority == g.priority)
+		return;
+	Entry& e = it->second;
+
+	PriorityMap& typed = byType[e.type];
+	std::pair<PriorityMap::iterator, PriorityMap::iterator> pr = typed.equal_range(e.priority);
+	for (PriorityMap::iterator pit = pr.first; pit != pr.second; ++pit) {
+		if (pit->second == g.id) {
+			typed.erase(pit);
+			break;
+		}
+	}
+	e.priority = g.priority;
+	typed.insert(PriorityMap::value_type(e.priority, g.id));
+}
+
+
+void GoalIndex::clear()
+{
+	entries.clear();
+	for (int i = 0; i <= NO_TYPE; ++i)
+		byType[i].clear();
+	byCell.clear();
+}
+
+
+void GoalIndex::GetGoalsOfType(Type type, std::vector<int>& out) const
+{
+	for (PriorityMap::const_iterator it = byType[type].begin(); it != byType[type].end(); ++it)
+		out.push_back(it->second);
+}
+
+
+void GoalIndex::FindGoalsNear(Type type, const float3& pos, float radius, std::vector<int>& out) const
+{
+	const float sqradius = radius*radius;
+	const int minx = CellCoord(pos.x - radius), maxx = CellCoord(pos.x + radius);
+	const int minz = CellCoord(pos.z - radius), maxz = CellCoord(pos.z + radius);
+
+	for (int cx = minx; cx <= maxx; ++cx) {
+		for (int cz = minz; cz <= maxz; ++cz) {
+			std::pair<CellMap::const_iterator, CellMap::const_iterator> cr =
+				byCell.equal_range(CellKey(type, cx, cz));
+			for (CellMap::const_iterator it = cr.first; it != cr.second; ++it) {
+				EntryMap::const_iterator e = entries.find(it->second);
+				assert(e != entries.end());
+				if (e->second.pos.SqDistance2D(pos) < sqradius)
+					out.push_back(it->second);
+			}
+		}
+	}
+}
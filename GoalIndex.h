@@ -0,0 +1,60 @@
+#pragma once
+
+#include <algorithm>
+#include <map>
+#include <vector>
+#include <boost/unordered_map.hpp>
+
+#include "float3.h"
+
+#include "Goal.h"
+
+/// secondary indexes over the goals of a single GoalProcessor
+///
+/// Goals are indexed by type (with their priorities, so the highest one is
+/// known) and, when params[0] is a float3, by quantized position.
+/// Only live goals are indexed, GoalProcessor drops them when they finish.
+class GoalIndex
+{
+public:
+	GoalIndex() {}
+
+	/// size of a spatial cell in elmos
+	static const int CELL_SIZE = 64;
+
+	void Insert(Goal& g);
+	void Erase(int goalId);
+	/// moves the goal to its current priority
+	void Reprioritize(Goal& g);
+	void clear();
+
+	bool HaveType(Type type) const { return !byType[type].empty(); }
+	bool HaveType(Type type, int minPriority) const
+	{
+		return !byType[type].empty() && byType[type].rbegin()->first >= minPriority;
+	}
+	int CountType(Type type) const { return byType[type].size(); }
+
+	void GetGoalsOfType(Type type, std::vector<int>& out) const;
+	/// goals of given type with params[0] closer than radius to pos (2D)
+	void FindGoalsNear(Type type, const float3& pos, float radius, std::vector<int>& out) const;
+
+protected:
+	struct Entry {
+		Type type;
+		int priority;
+		bool hasPos;
+		float3 pos;
+	};
+
+	typedef std::multimap<int, int> PriorityMap; //<! priority -> goal id
+	typedef boost::unordered_multimap<int, int> CellMap; //<! cell key -> goal id
+	typedef std::map<int, Entry> EntryMap; //<! goal id -> indexed data
+
+	EntryMap entries;
+	PriorityMap byType[NO_TYPE+1];
+	CellMap byCell;
+
+	static int CellCoord(float x) { return std::max(0, (int)(x / CELL_SIZE)); }
+	static int CellKey(Type type, int cx, int cz) { return (type << 24) | ((cx & 0xfff) << 12) | (cz & 0xfff); }
+};
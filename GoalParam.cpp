@@ -0,0 +1,54 @@
+#include <deque>
+#include <map>
+#include <boost/thread/mutex.hpp>
+
+#include "GoalParam.h"
+
+
+// string params are rare (unit def names and such), keep them in a table
+// so GoalParam stays a POD-sized value
+// The table is shared by all AI instances, so it's locked; a deque never
+// moves its elements, so returned references stay valid.
+static boost::mutex g_internMutex;
+static std::deque<std::string> g_internedStrings;
+static std::map<std::string, int> g_stringIds;
+
+
+int GoalParam::Intern(const std::string& s)
+{
+	boost::mutex::scoped_lock lock(g_internMutex);
+	std::map<std::string, int>::iterator it = g_stringIds.find(s);
+	if (it != g_stringIds.end())
+		return it->second;
+	int id = g_internedStrings.size();
+	g_internedStrings.push_back(s);
+	g_stringIds.insert(std::make_pair(s, id));
+	return id;
+}
+
+const std::string& GoalParam::InternedString(int id)
+{
+	boost::mutex::scoped_lock lock(g_internMutex);
+	assert(id >= 0 && id < (int)g_internedStrings.size());
+	return g_internedStrings[id];
+}
+
+
+std::ostream& operator<<(std::ostream& os, const GoalParam& p)
+{
+	switch (p.kind) {
+		case GoalParam::INT:
+			os << p.as_int();
+			break;
+		case GoalParam::FLOAT3:
+			os << p.as_float3();
+			break;
+		case GoalParam::STRING:
+			os << p.as_string();
+			break;
+		default:
+			os << "<none>";
+			break;
+	}
+	return os;
+}
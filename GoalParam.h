@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cassert>
+#include <string>
+#include <vector>
+#include <iostream>
+
+#include "float3.h"
+
+
+// needed for GoalParam output
+inline std::ostream &operator <<(std::ostream& os, float3 f)
+{
+	os << f.x << " " << f.y << " " << f.z;
+	return os;
+}
+
+
+/// a single goal parameter: position, unit id or interned string
+///
+/// A plain tagged union: cheap to copy, the kind is checked with a compare.
+class GoalParam
+{
+public:
+	enum Kind {
+		NONE,
+		INT,
+		FLOAT3,
+		STRING,
+	};
+
+	GoalParam() : kind(NONE) { u.i = 0; }
+	GoalParam(int i) : kind(INT) { u.i = i; }
+	GoalParam(const float3& f) : kind(FLOAT3)
+	{
+		u.pos[0] = f.x;
+		u.pos[1] = f.y;
+		u.pos[2] = f.z;
+	}
+	GoalParam(const std::string& s) : kind(STRING) { u.i = Intern(s); }
+
+	Kind kind;
+
+	bool is_int() const { return kind == INT; }
+	bool is_float3() const { return kind == FLOAT3; }
+	bool is_string() const { return kind == STRING; }
+
+	int as_int() const { assert(is_int()); return u.i; }
+	float3 as_float3() const { assert(is_float3()); return float3(u.pos[0], u.pos[1], u.pos[2]); }
+	const std::string& as_string() const { assert(is_string()); return InternedString(u.i); }
+
+	static int Intern(const std::string& s);
+	static const std::string& InternedString(int id);
+
+protected:
+	union {
+		int i; //<! unit id or interned string id
+		float pos[3];
+	} u;
+};
+
+std::ostream& operator<<(std::ostream& os, const GoalParam& p);
+
+
+/// goal parameter list with inline storage for the common small case
+///
+/// Goals carry one parameter almost always, so INLINE_SIZE of them live
+/// inside the goal itself and only longer lists allocate.
+class GoalParams
+{
+public:
+	static const size_t INLINE_SIZE = 2;
+
+	typedef GoalParam value_type;
+	typedef GoalParam* iterator;
+	typedef const GoalParam* const_iterator;
+	typedef GoalParam& reference;
+	typedef const GoalParam& const_reference;
+	typedef size_t size_type;
+
+	GoalParams() : count(0), spill(0) {}
+	GoalParams(const GoalParams& o) : count(0), spill(0) { *this = o; }
+	~GoalParams() { delete spill; }
+
+	GoalParams& operator=(const GoalParams& o)
+	{
+		if (this == &o)
+			return *this;
+		clear();
+		for (const_iterator it = o.begin(); it != o.end(); ++it)
+			push_back(*it);
+		return *this;
+	}
+
+	void push_back(const GoalParam& p)
+	{
+		if (spill) {
+			spill->push_back(p);
+		} else if (count < INLINE_SIZE) {
+			inline_params[count] = p;
+		} else {
+			// rare - move everything to the heap
+			spill = new std::vector<GoalParam>(inline_params, inline_params + count);
+			spill->push_back(p);
+		}
+		++count;
+	}
+
+	void clear()
+	{
+		delete spill;
+		spill = 0;
+		count = 0;
+	}
+
+	size_t size() const { return count; }
+	bool empty() const { return count == 0; }
+
+	iterator begin() { return spill ? &(*spill)[0] : inline_params; }
+	iterator end() { return begin() + count; }
+	const_iterator begin() const { return spill ? &(*spill)[0] : inline_params; }
+	const_iterator end() const { return begin() + count; }
+
+	GoalParam& operator[](size_t i) { assert(i < count); return begin()[i]; }
+	const GoalParam& operator[](size_t i) const { assert(i < count); return begin()[i]; }
+
+protected:
+	size_t count;
+	GoalParam inline_params[INLINE_SIZE];
+	std::vector<GoalParam>* spill;
+};
@@ -1,30 +1,43 @@
 #include <string>
 #include <sstream>
+#include <algorithm>
 #include <boost/foreach.hpp>
 
 #include "Log.h"
 #include "GoalProcessor.h"
 
 
+struct IsFinishedGoal : std::unary_function<int, bool> {
+	const std::vector<int>& finished;
+	IsFinishedGoal(const std::vector<int>& f):finished(f) {}
+	bool operator()(int gid) const {
+		return std::binary_search(finished.begin(), finished.end(), gid);
+	}
+};
+
+/// drop goals that finished since last cleanup
+/// timeouts are handled by GoalRegistry::ExpireGoals, which aborts the goal and
+/// lands it here as well
 void GoalProcessor::CleanupGoals(int frame)
 {
-	GoalStack newgoals;
-	newgoals.reserve(goals.size());
-
-	BOOST_FOREACH(int gid, goals) {
-		Goal* goal = Goal::GetGoal(gid);
-		if (goal) {
-			// check for timeout
-			if ((goal->timeoutFrame >= 0 && goal->timeoutFrame <= frame)
-				|| goal->is_finished()) {
-				Goal::RemoveGoal(goal);
-				continue;
-			}
-			newgoals.push_back(gid);
-		}
+	if (finishedGoals.empty())
+		return;
+
+	std::sort(finishedGoals.begin(), finishedGoals.end());
+	finishedGoals.erase(std::unique(finishedGoals.begin(), finishedGoals.end()),
+		finishedGoals.end());
+
+	goals.erase(std::remove_if(goals.begin(), goals.end(), IsFinishedGoal(finishedGoals)),
+		goals.end());
+
+	// finished goals can't be deleted from inside their own events, do it now
+	std::vector<int> tmp;
+	tmp.swap(finishedGoals);
+	BOOST_FOREACH(int gid, tmp) {
+		Goal* goal = goalRegistry->GetGoal(gid);
+		if (goal)
+			goalRegistry->RemoveGoal(goal);
 	}
-
-	goals = newgoals;
 }
 
 void GoalProcessor::DumpGoalStack(std::string str)
@@ -33,17 +46,17 @@ void GoalProcessor::DumpGoalStack(std::string str)
 
 	ss << str << ":";
 	BOOST_FOREACH(int gid, goals) {
-		Goal* goal = Goal::GetGoal(gid);
+		Goal* goal = goalRegistry->GetGoal(gid);
 		if (goal) {
 			ss << "\ngoal id: " << gid << " type: " << goal->type
 				<< " flags " << std::hex << goal->flags << std::dec;
 			ss << " params: ";
-			BOOST_FOREACH(Goal::param_variant& param, goal->params) {
+			BOOST_FOREACH(const Goal::param_type& param, goal->params) {
 				ss << param << ", ";
 			}
 			ss << " priority: " << goal->priority;
 		}
 	}
 
-	ailog->info() << ss.str() << std::endl; 
+	LOG_INFO << ss.str() << std::endl; 
 }
@@ -2,13 +2,16 @@
 
 #include <string>
 #include <boost/foreach.hpp>
+#include <boost/bind.hpp>
+#include <boost/signal.hpp>
 
 #include "Goal.h"
+#include "GoalIndex.h"
 
-class GoalProcessor
+class GoalProcessor : public boost::signals::trackable
 {
 public:
-	GoalProcessor(void) {};
+	GoalProcessor(GoalRegistry* registry) : goalRegistry(registry) {};
 	virtual ~GoalProcessor(void) {};
 
 	enum goal_process_t {
@@ -18,32 +21,62 @@ public:
 		PROCESS_BREAK,
 	};
 
+	GoalRegistry* goalRegistry;
 	GoalStack goals;
+	/// goals which finished since last cleanup, filled by goal events
+	std::vector<int> finishedGoals;
+	/// live goals by type and position
+	GoalIndex index;
 
-	void AddGoal(Goal* g) { goals.push_back(g->id); }
+	void AddGoal(Goal* g)
+	{
+		assert(g);
+		goals.push_back(g->id);
+		if (g->is_finished()) {
+			finishedGoals.push_back(g->id);
+			return;
+		}
+		index.Insert(*g);
+		// trackable disconnects these when the processor goes away
+		g->OnComplete(boost::bind(&GoalProcessor::GoalFinished, this, _1));
+		g->OnAbort(boost::bind(&GoalProcessor::GoalFinished, this, _1));
+		g->OnPriorityChange(boost::bind(&GoalProcessor::GoalReprioritized, this, _1));
+		goalRegistry->ScheduleTimeout(g);
+	}
+
+	void GoalFinished(Goal& g)
+	{
+		finishedGoals.push_back(g.id);
+		index.Erase(g.id);
+	}
+
+	void GoalReprioritized(Goal& g)
+	{
+		index.Reprioritize(g);
+	}
 
 	Goal* GetTopGoal()
 	{
 		if (goals.empty())
 			return 0;
-		return Goal::GetGoal(
-			*std::max_element(goals.begin(), goals.end(), goal_priority_less()));
+		return goalRegistry->GetGoal(goals[goalRegistry->TopPriorityIndex(goals)]);
 	}
 
 	Goal* PopTopGoal()
 	{
 		if (goals.empty())
 			return 0;
-		GoalStack::iterator it = std::max_element(goals.begin(), goals.end(), goal_priority_less());
+		GoalStack::iterator it = goals.begin() + goalRegistry->TopPriorityIndex(goals);
 		int id = *it;
 		goals.erase(it);
-		return Goal::GetGoal(id);
+		index.Erase(id);
+		return goalRegistry->GetGoal(id);
 	}
 	
 	virtual void ProcessGoalStack(int frameNum)
 	{
 		BOOST_REVERSE_FOREACH(int gid, goals) {
-			Goal* g = Goal::GetGoal(gid);
+			Goal* g = goalRegistry->GetGoal(gid);
 			if (g) {
 				goal_process_t gp = ProcessGoal(g);
 				switch (gp) {
@@ -53,11 +86,11 @@ public:
 						break;
 					case PROCESS_POP_BREAK:
 						// goal will be removed later
-						Goal::RemoveGoal(g);
+						goalRegistry->RemoveGoal(g);
 						goto end;
 					case PROCESS_POP_CONTINUE:
 						// goal will be removed later
-						Goal::RemoveGoal(g);
+						goalRegistry->RemoveGoal(g);
 						break;
 				}
 			}
@@ -69,30 +102,16 @@ end:
 	virtual void CleanupGoals(int frameNum);
 	void DumpGoalStack(std::string str);
 
-	bool HaveGoalType(Type type) {
-		for (GoalStack::iterator it = goals.begin(); it != goals.end(); ++it) {
-			Goal* g = Goal::GetGoal(*it);
-			if (g && g->type == type) {
-				return true;
-			}
-		}
-		return false;
-	}
-
-	bool HaveGoalType(Type type, int minPriority) {
-		for (GoalStack::iterator it = goals.begin(); it != goals.end(); ++it) {
-			Goal* g = Goal::GetGoal(*it);
-			if (g && g->type == type && g->priority >= minPriority) {
-				return true;
-			}
-		}
-		return false;
-	}
+	bool HaveGoalType(Type type) { return index.HaveType(type); }
+	bool HaveGoalType(Type type, int minPriority) { return index.HaveType(type, minPriority); }
 
 	void AbortGoals(Type type) {
-		for (GoalStack::iterator it = goals.begin(); it != goals.end(); ++it) {
-			Goal* g = Goal::GetGoal(*it);
-			if (g && g->type == type && !g->is_finished()) {
+		// aborting modifies the index, work on a copy
+		std::vector<int> typed;
+		index.GetGoalsOfType(type, typed);
+		BOOST_FOREACH(int gid, typed) {
+			Goal* g = goalRegistry->GetGoal(gid);
+			if (g && !g->is_finished()) {
 				g->abort();
 			}
 		}
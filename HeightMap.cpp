@@ -0,0 +1,135 @@
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#include "ExternalAI/IAICallback.h"
+
+#include "Log.h"
+#include "MapCache.h"
+#include "HeightMap.h"
+
+
+HeightMap::HeightMap():
+		w(0), h(0)
+{
+}
+
+
+void HeightMap::Init(const float* src, int width, int height)
+{
+	SetHeights(src, width, height);
+	BuildSlopes();
+	LOG_INFO << "heightmap " << w << "x" << h << " cached, "
+		<< slopeMips.size() << " slope levels" << std::endl;
+}
+
+void HeightMap::SetHeights(const float* src, int width, int height)
+{
+	w = width;
+	h = height;
+	heights.assign(src, src + w*h);
+}
+
+void HeightMap::BuildSlopes()
+{
+	slopeMips.clear();
+	mipW.clear();
+	mipH.clear();
+
+	std::vector<float> slope(w*h, 0.f);
+	for (int z = 0; z < h; ++z) {
+		for (int x = 0; x < w; ++x) {
+			float here = heights[x + z*w];
+			float s = 0;
+			if (x+1 < w)
+				s = std::max(s, (float)fabs(heights[x+1 + z*w] - here));
+			if (z+1 < h)
+				s = std::max(s, (float)fabs(heights[x + (z+1)*w] - here));
+			slope[x + z*w] = s / SQUARE_SIZE;
+		}
+	}
+	slopeMips.push_back(slope);
+	mipW.push_back(w);
+	mipH.push_back(h);
+
+	// halve until a single block covers the map
+	while (mipW.back() > 1 || mipH.back() > 1) {
+		const std::vector<float>& prev = slopeMips.back();
+		int pw = mipW.back(), ph = mipH.back();
+		int nw = (pw + 1) / 2, nh = (ph + 1) / 2;
+		std::vector<float> next(nw*nh, 0.f);
+		for (int z = 0; z < ph; ++z) {
+			for (int x = 0; x < pw; ++x) {
+				float& m = next[x/2 + (z/2)*nw];
+				m = std::max(m, prev[x + z*pw]);
+			}
+		}
+		slopeMips.push_back(next);
+		mipW.push_back(nw);
+		mipH.push_back(nh);
+	}
+}
+
+
+float HeightMap::GetSquareHeight(int x, int z) const
+{
+	x = std::max(0, std::min(w-1, x));
+	z = std::max(0, std::min(h-1, z));
+	return heights[x + z*w];
+}
+
+float HeightMap::GetHeight(float x, float z) const
+{
+	float fx = x / SQUARE_SIZE - 0.5f;
+	float fz = z / SQUARE_SIZE - 0.5f;
+	fx = std::max(0.f, std::min((float)(w-1), fx));
+	fz = std::max(0.f, std::min((float)(h-1), fz));
+
+	int x0 = (int)fx, z0 = (int)fz;
+	int x1 = std::min(x0+1, w-1), z1 = std::min(z0+1, h-1);
+	float tx = fx - x0, tz = fz - z0;
+
+	const float* row0 = &heights[z0*w];
+	const float* row1 = &heights[z1*w];
+	float top = row0[x0] + (row0[x1] - row0[x0])*tx;
+	float bottom = row1[x0] + (row1[x1] - row1[x0])*tx;
+	return top + (bottom - top)*tz;
+}
+
+float HeightMap::GetMaxSlope(int level, int x, int z) const
+{
+	assert(level >= 0 && level < (int)slopeMips.size());
+	x = std::max(0, std::min(mipW[level]-1, x));
+	z = std::max(0, std::min(mipH[level]-1, z));
+	return slopeMips[level][x + z*mipW[level]];
+}
+
+
+void HeightMap::WriteSlopes(MapCacheWriter& out) const
+{
+	out.Write((boost::int32_t)slopeMips.size());
+	for (size_t i = 0; i < slopeMips.size(); ++i) {
+		out.Write((boost::int32_t)mipW[i]);
+		out.Write((boost::int32_t)mipH[i]);
+		out.WriteVector(slopeMips[i]);
+	}
+}
+
+bool HeightMap::ReadSlopes(MapCacheReader& in)
+{
+	boost::int32_t levels;
+	if (!in.Read(levels) || levels <= 0)
+		return false;
+	slopeMips.resize(levels);
+	mipW.resize(levels);
+	mipH.resize(levels);
+	for (int i = 0; i < levels; ++i) {
+		boost::int32_t mw, mh;
+		if (!in.Read(mw) || !in.Read(mh) || !in.ReadVector(slopeMips[i])
+				|| (int)slopeMips[i].size() != mw*mh)
+			return false;
+		mipW[i] = mw;
+		mipH[i] = mh;
+	}
+	return mipW[0] == w && mipH[0] == h;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <vector>
+
+/// copy of the map's heights with slope data for terrain queries
+///
+/// Heights are copied from the engine once and sampled with bilinear
+/// interpolation, heights of squares being at their centres. The slope of
+/// a square is the steepest step to its +x or +z neighbour in height per
+/// elmo; level k of the slope mips holds the max slope of each 2^k x 2^k
+/// block of squares.
+class MapCacheReader;
+class MapCacheWriter;
+
+class HeightMap
+{
+public:
+	HeightMap();
+
+	/// heights is w*h squares, row by row
+	void Init(const float* heights, int w, int h);
+	/// Init without building the slopes, for reading them from a MapCache
+	void SetHeights(const float* heights, int w, int h);
+	void BuildSlopes();
+
+	void WriteSlopes(MapCacheWriter& out) const;
+	bool ReadSlopes(MapCacheReader& in);
+	bool IsValid() const { return !heights.empty(); }
+
+	int w, h; //<! in squares
+
+	/// at a square, clamped to the map
+	float GetSquareHeight(int x, int z) const;
+	/// interpolated, coordinates in elmos
+	float GetHeight(float x, float z) const;
+
+	/// max slope of block (x, z) on the given mip level
+	float GetMaxSlope(int level, int x, int z) const;
+	int MipLevels() const { return slopeMips.size(); }
+	int MipWidth(int level) const { return mipW[level]; }
+	int MipHeight(int level) const { return mipH[level]; }
+
+protected:
+	std::vector<float> heights;
+	std::vector<std::vector<float> > slopeMips;
+	std::vector<int> mipW, mipH;
+};
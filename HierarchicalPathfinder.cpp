@@ -0,0 +1,307 @@
+#include <cassert>
+#include <cfloat>
+#include <functional>
+#include <queue>
+#include <utility>
+#include <algorithm>
+#include <cstdlib>
+#include <boost/foreach.hpp>
+
+#include "Log.h"
+#include "PassabilityGrid.h"
+#include "MapCache.h"
+#include "HierarchicalPathfinder.h"
+
+
+typedef std::pair<float, int> QueueItem; //<! cost, cell or node index
+typedef std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<QueueItem> > OpenQueue;
+
+static const int dx[8] = { 1, -1, 0, 0, 1, 1, -1, -1 };
+static const int dz[8] = { 0, 0, 1, -1, 1, -1, 1, -1 };
+static const float SQRT2 = 1.41421356f;
+
+
+HierarchicalPathfinder::HierarchicalPathfinder():
+		grid(0), clustersW(0), clustersH(0)
+{
+}
+
+
+void HierarchicalPathfinder::Init(const PassabilityGrid& g)
+{
+	grid = &g;
+	clustersW = (grid->w + CLUSTER_CELLS - 1) / CLUSTER_CELLS;
+	clustersH = (grid->h + CLUSTER_CELLS - 1) / CLUSTER_CELLS;
+	nodes.clear();
+	clusterNodes.assign(clustersW*clustersH, std::vector<int>());
+
+	std::vector<int> nodeByCell(grid->w*grid->h, -1);
+
+	// openings on the borders between clusters
+	for (int cz = 0; cz < clustersH; ++cz) {
+		for (int cx = 0; cx < clustersW; ++cx) {
+			int x0 = cx*CLUSTER_CELLS, z0 = cz*CLUSTER_CELLS;
+			int width = std::min(CLUSTER_CELLS, grid->w - x0);
+			int height = std::min(CLUSTER_CELLS, grid->h - z0);
+			if (cx+1 < clustersW)
+				AddEntrances(x0 + width - 1, z0, 0, 1, height, nodeByCell);
+			if (cz+1 < clustersH)
+				AddEntrances(x0, z0 + height - 1, 1, 0, width, nodeByCell);
+		}
+	}
+
+	// paths between the portals of each cluster
+	std::vector<float> dist;
+	int edgeCount = 0;
+	for (size_t c = 0; c < clusterNodes.size(); ++c) {
+		const std::vector<int>& members = clusterNodes[c];
+		for (size_t i = 0; i < members.size(); ++i) {
+			Node& from = nodes[members[i]];
+			LocalDistances(from.x, from.z, dist);
+			for (size_t j = 0; j < members.size(); ++j) {
+				if (i == j)
+					continue;
+				const Node& to = nodes[members[j]];
+				float d = dist[LocalIndex(c, to.x, to.z)];
+				if (d < FLT_MAX) {
+					from.edges.push_back(Edge(members[j], d));
+					++edgeCount;
+				}
+			}
+		}
+	}
+
+	LOG_INFO << "pathfinder: " << clustersW << "x" << clustersH << " clusters, "
+		<< nodes.size() << " portals, " << edgeCount << " edges" << std::endl;
+}
+
+
+int HierarchicalPathfinder::NodeAt(int x, int z, std::vector<int>& nodeByCell)
+{
+	int& id = nodeByCell[x + z*grid->w];
+	if (id < 0) {
+		id = nodes.size();
+		Node n;
+		n.x = x;
+		n.z = z;
+		n.cluster = ClusterOf(x, z);
+		nodes.push_back(n);
+		clusterNodes[n.cluster].push_back(id);
+	}
+	return id;
+}
+
+/// walks a border from (x0, z0) along (dx, dz), the other cluster is
+/// across it at (+dz, +dx); every open run gets one or two portals
+void HierarchicalPathfinder::AddEntrances(int x0, int z0, int dx, int dz, int length,
+		std::vector<int>& nodeByCell)
+{
+	int runStart = -1;
+	for (int i = 0; i <= length; ++i) {
+		int x = x0 + i*dx, z = z0 + i*dz;
+		bool open = i < length && grid->IsPassable(x, z) && grid->IsPassable(x + dz, z + dx);
+		if (open && runStart < 0) {
+			runStart = i;
+		} else if (!open && runStart >= 0) {
+			int runEnd = i - 1;
+			// long openings get a portal at each end so paths don't all
+			// squeeze through the middle
+			if (runEnd - runStart + 1 >= 6) {
+				AddEntrance(x0 + runStart*dx, z0 + runStart*dz, dz, dx, nodeByCell);
+				AddEntrance(x0 + runEnd*dx, z0 + runEnd*dz, dz, dx, nodeByCell);
+			} else {
+				int mid = (runStart + runEnd) / 2;
+				AddEntrance(x0 + mid*dx, z0 + mid*dz, dz, dx, nodeByCell);
+			}
+			runStart = -1;
+		}
+	}
+}
+
+void HierarchicalPathfinder::AddEntrance(int x, int z, int nx, int nz, std::vector<int>& nodeByCell)
+{
+	int a = NodeAt(x, z, nodeByCell);
+	int b = NodeAt(x + nx, z + nz, nodeByCell);
+	nodes[a].edges.push_back(Edge(b, (float)PassabilityGrid::CELL_SIZE));
+	nodes[b].edges.push_back(Edge(a, (float)PassabilityGrid::CELL_SIZE));
+}
+
+
+int HierarchicalPathfinder::LocalIndex(int cluster, int x, int z) const
+{
+	int ox = (cluster % clustersW)*CLUSTER_CELLS;
+	int oz = (cluster / clustersW)*CLUSTER_CELLS;
+	return (x - ox) + (z - oz)*CLUSTER_CELLS;
+}
+
+void HierarchicalPathfinder::LocalDistances(int x, int z, std::vector<float>& dist) const
+{
+	const int cluster = ClusterOf(x, z);
+	const int ox = (cluster % clustersW)*CLUSTER_CELLS;
+	const int oz = (cluster / clustersW)*CLUSTER_CELLS;
+	const int ex = std::min(ox + CLUSTER_CELLS, grid->w);
+	const int ez = std::min(oz + CLUSTER_CELLS, grid->h);
+	const float straight = (float)PassabilityGrid::CELL_SIZE;
+
+	dist.assign(CLUSTER_CELLS*CLUSTER_CELLS, FLT_MAX);
+	OpenQueue open;
+	dist[LocalIndex(cluster, x, z)] = 0;
+	open.push(QueueItem(0, LocalIndex(cluster, x, z)));
+
+	while (!open.empty()) {
+		QueueItem top = open.top();
+		open.pop();
+		if (top.first > dist[top.second])
+			continue;
+		int cx = ox + top.second % CLUSTER_CELLS;
+		int cz = oz + top.second / CLUSTER_CELLS;
+
+		for (int d = 0; d < 8; ++d) {
+			int nx = cx + dx[d], nz = cz + dz[d];
+			if (nx < ox || nz < oz || nx >= ex || nz >= ez || !grid->IsPassable(nx, nz))
+				continue;
+			if (d >= 4 && (!grid->IsPassable(nx, cz) || !grid->IsPassable(cx, nz)))
+				continue;
+			int next = LocalIndex(cluster, nx, nz);
+			float nd = top.first + (d < 4 ? straight : straight*SQRT2);
+			if (nd < dist[next]) {
+				dist[next] = nd;
+				open.push(QueueItem(nd, next));
+			}
+		}
+	}
+}
+
+
+/// octile distance, never more than the real path
+float HierarchicalPathfinder::Heuristic(int x0, int z0, int x1, int z1) const
+{
+	int ax = std::abs(x1 - x0), az = std::abs(z1 - z0);
+	int lo = std::min(ax, az), hi = std::max(ax, az);
+	return (hi - lo + lo*SQRT2) * PassabilityGrid::CELL_SIZE;
+}
+
+
+float HierarchicalPathfinder::PathLength(const float3& start, const float3& end) const
+{
+	// saves searching the whole graph for a path that isn't there
+	if (!grid || !grid->IsReachable(start, end))
+		return -1;
+
+	int sx = grid->CellX(start.x), sz = grid->CellZ(start.z);
+	int gx = grid->CellX(end.x), gz = grid->CellZ(end.z);
+	grid->SnapToPassable(sx, sz);
+	grid->SnapToPassable(gx, gz);
+
+	const int startCluster = ClusterOf(sx, sz);
+	const int goalCluster = ClusterOf(gx, gz);
+
+	std::vector<float> fromStart, toGoal;
+	LocalDistances(sx, sz, fromStart);
+	if (startCluster == goalCluster) {
+		// may miss a shorter way around through other clusters, good
+		// enough for an estimate
+		float d = fromStart[LocalIndex(startCluster, gx, gz)];
+		if (d < FLT_MAX)
+			return d;
+	}
+	LocalDistances(gx, gz, toGoal);
+
+	std::vector<float> cost(nodes.size(), FLT_MAX);
+	std::vector<char> closed(nodes.size(), 0);
+	OpenQueue open;
+
+	BOOST_FOREACH(int n, clusterNodes[startCluster]) {
+		float d = fromStart[LocalIndex(startCluster, nodes[n].x, nodes[n].z)];
+		if (d < FLT_MAX) {
+			cost[n] = d;
+			open.push(QueueItem(d + Heuristic(nodes[n].x, nodes[n].z, gx, gz), n));
+		}
+	}
+
+	float best = FLT_MAX;
+	while (!open.empty()) {
+		QueueItem top = open.top();
+		open.pop();
+		if (top.first >= best)
+			break;
+		int n = top.second;
+		if (closed[n])
+			continue;
+		closed[n] = 1;
+		const Node& node = nodes[n];
+
+		if (node.cluster == goalCluster) {
+			float d = toGoal[LocalIndex(goalCluster, node.x, node.z)];
+			if (d < FLT_MAX)
+				best = std::min(best, cost[n] + d);
+		}
+
+		BOOST_FOREACH(const Edge& e, node.edges) {
+			float nc = cost[n] + e.cost;
+			if (nc < cost[e.to]) {
+				cost[e.to] = nc;
+				open.push(QueueItem(nc + Heuristic(nodes[e.to].x, nodes[e.to].z, gx, gz), e.to));
+			}
+		}
+	}
+
+	return best < FLT_MAX ? best : -1;
+}
+
+
+void HierarchicalPathfinder::Write(MapCacheWriter& out) const
+{
+	out.Write((boost::int32_t)clustersW);
+	out.Write((boost::int32_t)clustersH);
+	out.Write((boost::int32_t)nodes.size());
+	BOOST_FOREACH(const Node& n, nodes) {
+		out.Write((boost::int32_t)n.x);
+		out.Write((boost::int32_t)n.z);
+		out.Write((boost::int32_t)n.edges.size());
+		BOOST_FOREACH(const Edge& e, n.edges) {
+			out.Write((boost::int32_t)e.to);
+			out.Write(e.cost);
+		}
+	}
+}
+
+bool HierarchicalPathfinder::Read(MapCacheReader& in, const PassabilityGrid& g)
+{
+	boost::int32_t cw, ch, count;
+	if (!in.Read(cw) || !in.Read(ch) || !in.Read(count) || count < 0)
+		return false;
+	grid = &g;
+	clustersW = cw;
+	clustersH = ch;
+	if (clustersW != (grid->w + CLUSTER_CELLS - 1) / CLUSTER_CELLS
+			|| clustersH != (grid->h + CLUSTER_CELLS - 1) / CLUSTER_CELLS) {
+		grid = 0;
+		return false;
+	}
+
+	nodes.assign(count, Node());
+	clusterNodes.assign(clustersW*clustersH, std::vector<int>());
+	for (int i = 0; i < count; ++i) {
+		Node& n = nodes[i];
+		boost::int32_t x, z, edgeCount;
+		if (!in.Read(x) || !in.Read(z) || !in.Read(edgeCount) || !grid->InBounds(x, z)) {
+			grid = 0;
+			return false;
+		}
+		n.x = x;
+		n.z = z;
+		n.cluster = ClusterOf(x, z);
+		clusterNodes[n.cluster].push_back(i);
+		for (int j = 0; j < edgeCount; ++j) {
+			boost::int32_t to;
+			float cost;
+			if (!in.Read(to) || !in.Read(cost) || to < 0 || to >= count) {
+				grid = 0;
+				return false;
+			}
+			n.edges.push_back(Edge(to, cost));
+		}
+	}
+	return true;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <vector>
+
+#include "float3.h"
+
+class PassabilityGrid;
+class MapCacheReader;
+class MapCacheWriter;
+
+/// approximate path lengths over a PassabilityGrid, HPA* style
+///
+/// The grid is split into clusters of CLUSTER_CELLS x CLUSTER_CELLS cells.
+/// Passable openings between neighbouring clusters get portal nodes, and
+/// portals of one cluster are linked with their distances inside it. A
+/// query searches inside the start and end clusters only and runs A* over
+/// the portal graph in between.
+///
+/// The graph is immutable after Init and queries keep their state on the
+/// stack, so PathLength may be called from any thread.
+class HierarchicalPathfinder
+{
+public:
+	HierarchicalPathfinder();
+
+	static const int CLUSTER_CELLS = 8;
+
+	/// grid must outlive the pathfinder
+	void Init(const PassabilityGrid& grid);
+
+	void Write(MapCacheWriter& out) const;
+	/// the graph must have been built over grid
+	bool Read(MapCacheReader& in, const PassabilityGrid& grid);
+	bool IsValid() const { return grid != 0; }
+
+	/// path length in elmos, -1 if there's no path
+	float PathLength(const float3& start, const float3& end) const;
+
+	size_t NodeCount() const { return nodes.size(); }
+
+protected:
+	struct Edge {
+		int to;
+		float cost;
+		Edge(int t, float c):to(t), cost(c) {}
+	};
+	struct Node {
+		int x, z; //<! cell
+		int cluster;
+		std::vector<Edge> edges;
+	};
+
+	const PassabilityGrid* grid;
+	int clustersW, clustersH;
+	std::vector<Node> nodes;
+	std::vector<std::vector<int> > clusterNodes;
+
+	int ClusterOf(int x, int z) const { return x/CLUSTER_CELLS + (z/CLUSTER_CELLS)*clustersW; }
+	int NodeAt(int x, int z, std::vector<int>& nodeByCell);
+	void AddEntrances(int x0, int z0, int dx, int dz, int length, std::vector<int>& nodeByCell);
+	void AddEntrance(int x, int z, int nx, int nz, std::vector<int>& nodeByCell);
+
+	/// Dijkstra limited to the cluster of (x, z), dist indexed by local cell
+	void LocalDistances(int x, int z, std::vector<float>& dist) const;
+	int LocalIndex(int cluster, int x, int z) const;
+	float Heuristic(int x0, int z0, int x1, int z1) const;
+};
@@ -2,7 +2,6 @@
 #include <algorithm>
 #include <boost/foreach.hpp>
 #include <boost/filesystem.hpp>
-#include <boost/timer.hpp>
 
 #include "json_spirit/json_spirit.h"
 
@@ -15,6 +14,7 @@
 #include "RStarTree/RStarTree.h"
 
 #include "Log.h"
+#include "Profiler.h"
 #include "InfluenceMap.h"
 #include "BaczekKPAI.h"
 
@@ -28,14 +28,8 @@ configName(cfg)
 	mapw = ai->cb->GetMapWidth()/influence_size_divisor;
 	scalex = scaley = 1./SQUARE_SIZE/influence_size_divisor;
 
-	map.resize(mapw);
-	workMap.resize(mapw);
-	BOOST_FOREACH(std::vector<int>& r, map) {
-		r.resize(maph);
-	}
-	BOOST_FOREACH(std::vector<int>& r, workMap) {
-		r.resize(maph);
-	}
+	map.resize(mapw, maph);
+	workMap.resize(mapw, maph);
 	lastMinimaFrame = -1;
 
 	alliedProgress = 0;
@@ -101,14 +95,13 @@ struct Visitor {
 
 void InfluenceMap::FindLocalMinima(float radius, std::vector<int> &values, std::vector<float3> &positions)
 {
-	boost::timer total;
+	PROFILE_ZONE("InfluenceMap::FindLocalMinima");
 
 	// cache results
 	int frameNum = ai->cb->GetCurrentFrame();
 	if (lastMinimaFrame == frameNum) {
 		values = minimaCachedValues;
 		positions = minimaCachedPositions;
-		ailog->info() << __FUNCTION__ << " cached " << total.elapsed() << std::endl;
 		return;
 	} else {
 		lastMinimaFrame = frameNum;
@@ -173,8 +166,6 @@ not_found:  ;
 	
 	minimaCachedValues = values;
 	minimaCachedPositions = positions;
-
-	ailog->info() << __FUNCTION__ << " " << total.elapsed() << std::endl;
 }
 
 
@@ -218,13 +209,9 @@ void InfluenceMap::FindLocalMinNear(float3 point, float3& retpoint, int& retval)
 void InfluenceMap::UpdateAll(const std::vector<int>& friends,
 						  const std::vector<int>& enemies)
 {
-	boost::timer total;
+	PROFILE_ZONE("InfluenceMap::UpdateAll");
 
-	for (int x=0; x<mapw; ++x) {
-		for (int y=0; y<maph; ++y) {
-			map[x][y] = 0;
-		}
-	}
+	map.clear();
 
 	BOOST_FOREACH(int uid, friends) {
 		// add friends to influence map
@@ -235,8 +222,6 @@ void InfluenceMap::UpdateAll(const std::vector<int>& friends,
 		// add enemies to influence map
 		UpdateSingleUnit(uid, -1, map);
 	}
-
-	ailog->info() << __FUNCTION__ << " " << total.elapsed() << std::endl;
 }
 
 // partial updates
@@ -259,24 +244,22 @@ void InfluenceMap::Update(const std::vector<int>& arg_friends,
 void InfluenceMap::StartPartialUpdate(const std::vector<int>& friends,
 						  const std::vector<int>& enemies)
 {
-	ailog->info() << "influence: starting partial update..." << std::endl;
+	LOG_INFO << "influence: starting partial update..." << std::endl;
 	alliedProgress = 0;
 	enemyProgress = 0;
 	updateInProgress = true;
 	enemiesDone = false;
-	for (int y = 0; y<maph; ++y)
-		for (int x = 0; x<mapw; ++x)
-			workMap[x][y] = 0;
+	workMap.clear();
 	this->friends = friends;
 	this->enemies = enemies;
 }
 
 void InfluenceMap::FinishPartialUpdate()
 {
-	// copy workMap onto map
-	map = workMap;
+	// copy workMap onto map, in place so map's cells don't move
+	std::copy(workMap.cells.begin(), workMap.cells.end(), map.cells.begin());
 	updateInProgress = false;
-	ailog->info() << "influence: finished partial update." << std::endl;
+	LOG_INFO << "influence: finished partial update." << std::endl;
 }
 
 bool InfluenceMap::UpdatePartial(bool allied, const std::vector<int> &uids)
@@ -287,7 +270,7 @@ bool InfluenceMap::UpdatePartial(bool allied, const std::vector<int> &uids)
 	int sign = (allied ? 1 : -1);
 	size_t nextStop = std::min(progress + 50, uids.size()); // XXX make configureable?
 
-	ailog->info() << "influence: partial update of " << (allied ? "friends" : "enemies")
+	LOG_INFO << "influence: partial update of " << (allied ? "friends" : "enemies")
 		<< " from " << progress << " to " << nextStop << std::endl;
 
 	for (; progress < nextStop; ++progress) {
@@ -311,7 +294,7 @@ void InfluenceMap::UpdateSingleUnit(int uid, int sign, map_t& themap)
 
 	if (it == unit_map.end()) {
 		// unit not found in influence map
-		ailog->error() << "unit data for influence map not found for "
+		LOG_ERROR << "unit data for influence map not found for "
 			<< ud->name << std::endl;
 		float3 pos = ai->cheatcb->GetUnitPos(uid);
 		int x = (int)(pos.x * scalex);
@@ -444,4 +427,4 @@ void InfluenceMap::WriteDefaultJSONConfig(std::string configName) {
 
 	std::ofstream os(configName.c_str());
 	json_spirit::write_formatted(root, os);
-}
\ No newline at end of file
+}
\ No newline at end of file
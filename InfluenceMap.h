@@ -1,5 +1,6 @@
 #pragma once
 
+#include <algorithm>
 #include <map>
 #include <string>
 #include <vector>
@@ -45,7 +46,18 @@ public:
 	int mapw, maph;
 	float scalex, scaley;
 
-	typedef std::vector<std::vector<int> > map_t;
+	/// w*h cells in one block indexed [x][y], the block never moves
+	/// so it can be handed out (see PythonScripting::ExposeWorld)
+	struct Grid {
+		std::vector<int> cells;
+		int h;
+		Grid():h(0) {}
+		void resize(int w, int height) { h = height; cells.assign(w*h, 0); }
+		void clear() { std::fill(cells.begin(), cells.end(), 0); }
+		int* operator[](int x) { return &cells[x*h]; }
+		const int* operator[](int x) const { return &cells[x*h]; }
+	};
+	typedef Grid map_t;
 
 	map_t map;
 	map_t workMap;
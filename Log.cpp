@@ -0,0 +1,245 @@
+#include <csignal>
+#include <cassert>
+#include <cerrno>
+#include <fcntl.h>
+#include <boost/bind.hpp>
+#include <boost/foreach.hpp>
+
+#ifdef _WIN32
+#	define WIN32_LEAN_AND_MEAN
+#	include <windows.h>
+#	include <io.h>
+#	define raw_open ::_open
+#	define raw_write ::_write
+#	define raw_close ::_close
+#	define RAW_APPEND (_O_WRONLY | _O_APPEND | _O_BINARY)
+#else
+#	include <unistd.h>
+#	define raw_open ::open
+#	define raw_write ::write
+#	define raw_close ::close
+#	define RAW_APPEND (O_WRONLY | O_APPEND)
+#endif
+
+#include "Log.h"
+
+
+////////////////////////////////////////////////////////////////////////////////
+// crash handling
+
+static Log* g_crashLog = 0;
+
+#ifdef _WIN32
+
+static LPTOP_LEVEL_EXCEPTION_FILTER g_prevFilter = 0;
+
+static LONG WINAPI CrashFilter(EXCEPTION_POINTERS* info)
+{
+	if (g_crashLog)
+		g_crashLog->FlushNow();
+	return g_prevFilter ? g_prevFilter(info) : EXCEPTION_CONTINUE_SEARCH;
+}
+
+static void InstallCrashHandler()
+{
+	g_prevFilter = SetUnhandledExceptionFilter(CrashFilter);
+}
+
+static void UninstallCrashHandler()
+{
+	SetUnhandledExceptionFilter(g_prevFilter);
+	g_prevFilter = 0;
+}
+
+#else
+
+typedef void (*signal_handler_t)(int);
+static const int g_crashSignals[] = { SIGSEGV, SIGABRT, SIGFPE, SIGILL, SIGBUS };
+static const int NUM_CRASH_SIGNALS = sizeof(g_crashSignals)/sizeof(g_crashSignals[0]);
+static signal_handler_t g_prevHandlers[NUM_CRASH_SIGNALS];
+
+static void CrashSignal(int sig)
+{
+	if (g_crashLog)
+		g_crashLog->FlushNow();
+	// hand over to whoever was there before us (spring's crash handler)
+	for (int i = 0; i < NUM_CRASH_SIGNALS; ++i) {
+		if (g_crashSignals[i] == sig) {
+			signal(sig, g_prevHandlers[i]);
+			break;
+		}
+	}
+	raise(sig);
+}
+
+static void InstallCrashHandler()
+{
+	for (int i = 0; i < NUM_CRASH_SIGNALS; ++i)
+		g_prevHandlers[i] = signal(g_crashSignals[i], CrashSignal);
+}
+
+static void UninstallCrashHandler()
+{
+	for (int i = 0; i < NUM_CRASH_SIGNALS; ++i)
+		signal(g_crashSignals[i], g_prevHandlers[i]);
+}
+
+#endif
+
+/// write(2) all of s, only async-signal-safe calls
+static void RawWrite(int fd, const char* s, size_t len)
+{
+	while (len > 0) {
+		int n = raw_write(fd, s, len);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return;
+		s += n;
+		len -= n;
+	}
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Log
+
+Log::Log(IGlobalAICallback* cb):
+		crashFd(-1), callback(cb), level(LVL_INFO), running(false),
+		queueBusy(0), written(0), pushed(0), writer(0)
+{
+}
+
+Log::~Log()
+{
+	close();
+}
+
+
+void Log::open(const char* name)
+{
+	assert(!writer);
+	logfile.open(name);
+	// opened up front, a crash handler can't open files
+	crashFd = raw_open(name, RAW_APPEND);
+	running = true;
+	writer = new boost::thread(boost::bind(&Log::WriterLoop, this));
+
+	if (!g_crashLog) {
+		g_crashLog = this;
+		InstallCrashHandler();
+	}
+}
+
+void Log::close()
+{
+	if (!writer)
+		return;
+	{
+		boost::mutex::scoped_lock lock(queueMutex);
+		running = false;
+		queueCond.notify_one();
+	}
+	writer->join();
+	delete writer;
+	writer = 0;
+
+	if (g_crashLog == this) {
+		UninstallCrashHandler();
+		g_crashLog = 0;
+	}
+	if (crashFd >= 0) {
+		raw_close(crashFd);
+		crashFd = -1;
+	}
+	logfile.close();
+}
+
+void Log::flush()
+{
+	boost::mutex::scoped_lock lock(queueMutex);
+	size_t target = pushed;
+	queueCond.notify_one();
+	while (running && written < target)
+		writtenCond.wait(lock);
+}
+
+
+void Log::Push(std::string& record, int recordLevel)
+{
+	boost::mutex::scoped_lock lock(queueMutex);
+	queueBusy = 1;
+	queue.push_back(std::string());
+	queue.back().swap(record);
+	queueBusy = 0;
+	++pushed;
+	if (recordLevel >= LVL_ERROR || queue.size() >= BATCH_SIZE)
+		queueCond.notify_one();
+}
+
+
+void Log::WriterLoop()
+{
+	std::vector<std::string> batch;
+	boost::mutex::scoped_lock lock(queueMutex);
+	for (;;) {
+		if (queue.empty()) {
+			if (!running)
+				break;
+			// write at least a few times a second even when it's quiet
+			queueCond.timed_wait(lock, boost::posix_time::milliseconds(200));
+			continue;
+		}
+
+		queueBusy = 1;
+		batch.swap(queue);
+		queueBusy = 0;
+		lock.unlock();
+		size_t count = batch.size();
+		Write(batch);
+		lock.lock();
+
+		written += count;
+		writtenCond.notify_all();
+	}
+}
+
+void Log::Write(std::vector<std::string>& batch)
+{
+	boost::mutex::scoped_lock lock(fileMutex);
+	BOOST_FOREACH(const std::string& s, batch) {
+		logfile << s;
+	}
+	logfile.flush();
+	batch.clear();
+}
+
+
+void Log::FlushNow()
+{
+	// Called from a signal handler: the crashed thread may hold any lock or
+	// be inside malloc, so only read the queue and write(2) it. Records in
+	// a batch the writer is in the middle of are lost.
+	if (crashFd < 0 || queueBusy)
+		return;
+	for (size_t i = 0; i < queue.size(); ++i)
+		RawWrite(crashFd, queue[i].data(), queue[i].size());
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// LogRecord
+
+static const char* levelPrefix[] = { "DEBUG:", "INFO:", "ERROR:" };
+
+LogRecord::LogRecord(Log& l, int lvl):
+		log(l), level(lvl)
+{
+	buffer << levelPrefix[lvl];
+}
+
+LogRecord::~LogRecord()
+{
+	std::string s = buffer.str();
+	log.Push(s, level);
+}
@@ -1,7 +1,12 @@
 #pragma once
 
+#include <csignal>
 #include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
 #include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
 
 #ifdef _MSC_VER
 #pragma warning (disable: 4996) // secure iterators
@@ -14,27 +19,97 @@
 #include "ExternalAI/IGlobalAICallback.h"
 
 
+/// records below this level are compiled out
+#ifndef AILOG_MIN_LEVEL
+#	define AILOG_MIN_LEVEL 0
+#endif
+
+
+/// leveled log written by a background thread
+///
+/// Use the LOG_DEBUG, LOG_INFO and LOG_ERROR macros: a record below the
+/// current level costs one branch, its arguments aren't even evaluated.
+/// Records are queued and written in batches; error records wake the
+/// writer right away. On a crash the records still queued are written
+/// out with plain write(2) calls, see FlushNow.
 class Log
 {
+public:
+	enum Level {
+		LVL_DEBUG = 0,
+		LVL_INFO = 1,
+		LVL_ERROR = 2,
+	};
+
+	Log(IGlobalAICallback* cb);
+	~Log();
+
+	void open(const char* name);
+	/// stop the writer, everything queued so far is written
+	void close();
+	/// wait until everything queued so far is written
+	void flush();
+
+	void SetLevel(int l) { level = l; }
+	bool enabled(int l) const { return l >= level && running; }
+
+	/// queue a record, record is left empty
+	void Push(std::string& record, int recordLevel);
+	/// write queued records from a crash handler
+	///
+	/// Async-signal-safe: no locks, no allocation, no streams, just write(2)
+	/// on crashFd. Gives up if another thread is changing the queue.
+	void FlushNow();
+
+protected:
 	std::ofstream logfile;
+	int crashFd; //<! second descriptor of the log file for FlushNow, -1 if none
 	IGlobalAICallback* callback;
-public:
+	volatile int level;
+	volatile bool running;
 
-	Log(IGlobalAICallback* cb):callback(cb)
-	{
-	}
+	static const size_t BATCH_SIZE = 256; //<! records queued before waking the writer
 
-	~Log()
-	{
-		logfile.close();
-	}
+	boost::mutex queueMutex;
+	boost::condition_variable queueCond;
+	std::vector<std::string> queue;
+	volatile sig_atomic_t queueBusy; //<! set while queue is being changed
+	size_t written; //<! records written, for flush
+	size_t pushed;
+	boost::condition_variable writtenCond;
 
-	void flush() { logfile.flush(); }
-	void open(const char* name) { logfile.open(name); }
-	void close() { logfile.close(); }
+	boost::mutex fileMutex;
+	boost::thread* writer;
 
-	std::ofstream& error() { flush(); logfile << "ERROR:"; return logfile; }
-	std::ofstream& info() { flush(); logfile << "INFO:"; return logfile; }
+	void WriterLoop();
+	void Write(std::vector<std::string>& batch);
 };
 
 extern boost::shared_ptr<Log> ailog;
+
+
+/// builds one record and queues it when done
+class LogRecord
+{
+public:
+	LogRecord(Log& l, int lvl);
+	~LogRecord();
+	std::ostream& stream() { return buffer; }
+protected:
+	Log& log;
+	int level;
+	std::ostringstream buffer;
+};
+
+/// turns the stream expression into void for the ?: in AILOG
+struct LogVoidify {
+	void operator&(std::ostream&) {}
+};
+
+#define AILOG(lvl) \
+	!((lvl) >= AILOG_MIN_LEVEL && ailog && ailog->enabled(lvl)) ? (void)0 \
+		: LogVoidify() & LogRecord(*ailog, lvl).stream()
+
+#define LOG_DEBUG AILOG(Log::LVL_DEBUG)
+#define LOG_INFO AILOG(Log::LVL_INFO)
+#define LOG_ERROR AILOG(Log::LVL_ERROR)
@@ -0,0 +1,156 @@
+#include <cctype>
+#include <boost/filesystem.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include "Log.h"
+#include "HeightMap.h"
+#include "PassabilityGrid.h"
+#include "HierarchicalPathfinder.h"
+#include "MapCache.h"
+
+namespace bip = boost::interprocess;
+
+
+MapCache::Header::Header():
+		magic(MAGIC), version(VERSION), mapHash(0), w(0), h(0), maxGradient(0),
+		cellSquares(PassabilityGrid::CELL_SQUARES),
+		clusterCells(HierarchicalPathfinder::CLUSTER_CELLS)
+{
+}
+
+bool MapCache::Header::operator==(const Header& o) const
+{
+	return magic == o.magic && version == o.version && mapHash == o.mapHash
+		&& w == o.w && h == o.h && maxGradient == o.maxGradient
+		&& cellSquares == o.cellSquares && clusterCells == o.clusterCells;
+}
+
+
+MapCache::MapCache(const std::string& name):
+		fileName(name)
+{
+}
+
+MapCache::~MapCache()
+{
+	Close();
+}
+
+
+std::string MapCache::FileNameFor(const std::string& dir, const std::string& mapName)
+{
+	std::string safe(mapName);
+	for (size_t i = 0; i < safe.size(); ++i) {
+		char c = safe[i];
+		if (!isalnum((unsigned char)c) && c != '.' && c != '-' && c != '_')
+			safe[i] = '_';
+	}
+	return dir + "mapcache/" + safe + ".bin";
+}
+
+
+bool MapCache::Load(const Header& expected, std::vector<float3>& geovents, HeightMap& heightmap,
+		PassabilityGrid& passability, HierarchicalPathfinder& pathfinder)
+{
+	if (!boost::filesystem::is_regular_file(boost::filesystem::path(fileName)))
+		return false;
+
+	const char* data;
+	size_t size;
+	try {
+		file.reset(new bip::file_mapping(fileName.c_str(), bip::read_only));
+		region.reset(new bip::mapped_region(*file, bip::read_only));
+		data = (const char*)region->get_address();
+		size = region->get_size();
+	} catch (bip::interprocess_exception& e) {
+		LOG_ERROR << "can't map " << fileName << ": " << e.what() << std::endl;
+		Close();
+		return false;
+	}
+
+	MapCacheReader in(data, size);
+	Header header;
+	if (!in.Read(header) || !(header == expected)) {
+		LOG_INFO << fileName << " is out of date" << std::endl;
+		Close();
+		return false;
+	}
+
+	std::vector<float> geoCoords;
+	bool ok = in.ReadVector(geoCoords) && geoCoords.size() % 3 == 0;
+	if (ok) {
+		geovents.clear();
+		for (size_t i = 0; i < geoCoords.size(); i += 3)
+			geovents.push_back(float3(geoCoords[i], geoCoords[i+1], geoCoords[i+2]));
+	}
+	ok = ok && heightmap.ReadSlopes(in)
+		&& passability.Read(in)
+		&& pathfinder.Read(in, passability);
+	Close();
+
+	if (!ok) {
+		LOG_ERROR << fileName << " is broken" << std::endl;
+		return false;
+	}
+	LOG_INFO << "map analysis loaded from " << fileName << std::endl;
+	return true;
+}
+
+
+bool MapCache::Save(const Header& header, const std::vector<float3>& geovents, const HeightMap& heightmap,
+		const PassabilityGrid& passability, const HierarchicalPathfinder& pathfinder)
+{
+	// the mapping must be gone before the file is replaced
+	Close();
+
+	boost::filesystem::path path(fileName);
+	std::string tmpName = fileName + ".tmp";
+	try {
+		boost::filesystem::create_directories(path.parent_path());
+	} catch (boost::filesystem::filesystem_error& e) {
+		LOG_ERROR << "can't create cache dir: " << e.what() << std::endl;
+		return false;
+	}
+
+	{
+		std::ofstream os(tmpName.c_str(), std::ios::binary);
+		MapCacheWriter out(os);
+		out.Write(header);
+
+		std::vector<float> geoCoords;
+		for (size_t i = 0; i < geovents.size(); ++i) {
+			geoCoords.push_back(geovents[i].x);
+			geoCoords.push_back(geovents[i].y);
+			geoCoords.push_back(geovents[i].z);
+		}
+		out.WriteVector(geoCoords);
+		heightmap.WriteSlopes(out);
+		passability.Write(out);
+		pathfinder.Write(out);
+
+		if (!os) {
+			LOG_ERROR << "can't write " << tmpName << std::endl;
+			return false;
+		}
+	}
+
+	// readers never see a half written file
+	try {
+		if (boost::filesystem::exists(path))
+			boost::filesystem::remove(path);
+		boost::filesystem::rename(boost::filesystem::path(tmpName), path);
+	} catch (boost::filesystem::filesystem_error& e) {
+		LOG_ERROR << "can't replace " << fileName << ": " << e.what() << std::endl;
+		return false;
+	}
+	LOG_INFO << "map analysis saved to " << fileName << std::endl;
+	return true;
+}
+
+
+void MapCache::Close()
+{
+	region.reset();
+	file.reset();
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <boost/cstdint.hpp>
+#include <boost/scoped_ptr.hpp>
+
+#include "float3.h"
+
+namespace boost { namespace interprocess {
+	class file_mapping;
+	class mapped_region;
+} }
+
+class HeightMap;
+class PassabilityGrid;
+class HierarchicalPathfinder;
+
+/// reads plain values from a memory block, sets ok to false on overrun
+class MapCacheReader
+{
+public:
+	MapCacheReader(const char* data, size_t size):ok(true), p(data), end(data+size) {}
+
+	template<typename T> bool Read(T& value)
+	{
+		if (!ok || (size_t)(end - p) < sizeof(T))
+			return ok = false;
+		memcpy(&value, p, sizeof(T));
+		p += sizeof(T);
+		return true;
+	}
+
+	/// count followed by the elements
+	template<typename T> bool ReadVector(std::vector<T>& v)
+	{
+		boost::uint32_t n;
+		if (!Read(n) || (size_t)(end - p) / sizeof(T) < n)
+			return ok = false;
+		v.resize(n);
+		if (n)
+			memcpy(&v[0], p, n*sizeof(T));
+		p += n*sizeof(T);
+		return true;
+	}
+
+	bool ok;
+
+protected:
+	const char* p;
+	const char* end;
+};
+
+/// writes what MapCacheReader reads
+class MapCacheWriter
+{
+public:
+	MapCacheWriter(std::ostream& s):os(s) {}
+
+	template<typename T> void Write(const T& value)
+	{
+		os.write((const char*)&value, sizeof(T));
+	}
+
+	template<typename T> void WriteVector(const std::vector<T>& v)
+	{
+		Write((boost::uint32_t)v.size());
+		if (!v.empty())
+			os.write((const char*)&v[0], v.size()*sizeof(T));
+	}
+
+protected:
+	std::ostream& os;
+};
+
+
+/// per-map analysis results stored in the AI data dir
+///
+/// Holds geovents, heightmap slope mips, the passability grid with its
+/// components and the pathfinder graph. The file starts with a header with
+/// a format version, the map hash and size and the settings and grid
+/// constants the analysis depends on; any mismatch means the file is
+/// rebuilt. It's read through
+/// a read-only memory mapping.
+class MapCache
+{
+public:
+	static const boost::uint32_t MAGIC = 0x434d504b; //<! "KPMC"
+	static const boost::uint32_t VERSION = 2;
+
+	struct Header {
+		boost::uint32_t magic;
+		boost::uint32_t version;
+		boost::uint32_t mapHash;
+		boost::int32_t w, h;
+		float maxGradient; //<! passability setting
+		boost::int32_t cellSquares; //<! PassabilityGrid::CELL_SQUARES
+		boost::int32_t clusterCells; //<! HierarchicalPathfinder::CLUSTER_CELLS
+		Header();
+		bool operator==(const Header& o) const;
+	};
+
+	MapCache(const std::string& fileName);
+	~MapCache();
+
+	/// false if the file is missing, stale or broken; the outputs are
+	/// then partially filled and must be rebuilt
+	bool Load(const Header& expected, std::vector<float3>& geovents, HeightMap& heightmap,
+			PassabilityGrid& passability, HierarchicalPathfinder& pathfinder);
+	bool Save(const Header& header, const std::vector<float3>& geovents, const HeightMap& heightmap,
+			const PassabilityGrid& passability, const HierarchicalPathfinder& pathfinder);
+
+	/// file name for a map in dir
+	static std::string FileNameFor(const std::string& dir, const std::string& mapName);
+
+protected:
+	std::string fileName;
+	boost::scoped_ptr<boost::interprocess::file_mapping> file;
+	boost::scoped_ptr<boost::interprocess::mapped_region> region;
+
+	void Close();
+};
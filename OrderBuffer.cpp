@@ -0,0 +1,181 @@
+#include <cmath>
+#include <climits>
+#include <boost/foreach.hpp>
+
+#include "OrderBuffer.h"
+
+
+OrderBuffer::OrderBuffer()
+{
+}
+
+
+/// orders which replace the whole command queue when given without shift
+bool OrderBuffer::IsQueueOrder(const Command& c)
+{
+	if (c.options & SHIFT_KEY)
+		return false;
+	switch (c.id) {
+		case CMD_STOP:
+		case CMD_MOVE:
+		case CMD_PATROL:
+		case CMD_FIGHT:
+		case CMD_ATTACK:
+		case CMD_GUARD:
+			return true;
+		default:
+			return false;
+	}
+}
+
+/// orders which set a unit state and don't touch the command queue
+bool OrderBuffer::IsStateOrder(const Command& c)
+{
+	switch (c.id) {
+		case CMD_FIRE_STATE:
+		case CMD_MOVE_STATE:
+		case CMD_REPEAT:
+			return c.params.size() == 1;
+		default:
+			return false;
+	}
+}
+
+bool OrderBuffer::SameOrder(const Command& a, const Command& b)
+{
+	if (a.id != b.id || a.params.size() != b.params.size())
+		return false;
+	// the engine puts positions on the ground, don't compare heights
+	bool isPos = (a.id == CMD_MOVE || a.id == CMD_PATROL || a.id == CMD_FIGHT)
+		&& a.params.size() >= 3;
+	for (size_t i = 0; i < a.params.size(); ++i) {
+		if (isPos && i == 1)
+			continue;
+		if (std::fabs(a.params[i] - b.params[i]) > 0.5f)
+			return false;
+	}
+	return true;
+}
+
+
+void OrderBuffer::GiveOrder(int unitId, const Command& c)
+{
+	++current.given;
+
+	std::vector<int>& indices = pendingByUnit[unitId];
+	bool queueOrder = IsQueueOrder(c);
+	bool stateOrder = IsStateOrder(c);
+	if (queueOrder || stateOrder) {
+		BOOST_FOREACH(int i, indices) {
+			Order& o = pending[i];
+			if (o.dropped)
+				continue;
+			// a queue order makes all earlier queue orders moot,
+			// a state order only the earlier ones of the same state
+			bool moot;
+			if (queueOrder)
+				moot = IsQueueOrder(o.command)
+					|| (!IsStateOrder(o.command) && (o.command.options & SHIFT_KEY));
+			else
+				moot = IsStateOrder(o.command) && o.command.id == c.id;
+			if (moot) {
+				o.dropped = true;
+				++current.coalesced;
+			}
+		}
+	}
+
+	indices.push_back(pending.size());
+	pending.push_back(Order(unitId, c));
+}
+
+
+bool OrderBuffer::IsRepeat(IAICallback* cb, const Order& o)
+{
+	const Command& c = o.command;
+	if (IsStateOrder(c)) {
+		std::map<std::pair<int, int>, float>::iterator it
+			= lastState.find(std::make_pair(o.unitId, c.id));
+		return it != lastState.end() && it->second == c.params[0];
+	}
+
+	if (!IsQueueOrder(c))
+		return false;
+	std::map<int, Command>::iterator it = lastQueueOrder.find(o.unitId);
+	if (it == lastQueueOrder.end() || !SameOrder(it->second, c))
+		return false;
+	// the unit may have finished or dropped it since, check what it's doing
+	const CCommandQueue* q = cb->GetCurrentUnitCommands(o.unitId);
+	if (!q)
+		return false;
+	if (c.id == CMD_STOP)
+		return q->empty();
+	return !q->empty() && SameOrder(q->front(), c);
+}
+
+void OrderBuffer::Sent(const Order& o)
+{
+	const Command& c = o.command;
+	if (IsStateOrder(c)) {
+		lastState[std::make_pair(o.unitId, c.id)] = c.params[0];
+	} else if (IsQueueOrder(c)) {
+		lastQueueOrder[o.unitId] = c;
+	} else {
+		// something else changed the queue
+		lastQueueOrder.erase(o.unitId);
+	}
+}
+
+
+void OrderBuffer::Flush(IAICallback* cb)
+{
+	BOOST_FOREACH(Order& o, pending) {
+		if (o.dropped)
+			continue;
+		if (IsRepeat(cb, o)) {
+			++current.repeated;
+			continue;
+		}
+		cb->GiveOrder(o.unitId, &o.command);
+		Sent(o);
+		++current.sent;
+	}
+	pending.clear();
+	pendingByUnit.clear();
+}
+
+void OrderBuffer::EndFrame()
+{
+	lastFrame = current;
+	total.given += current.given;
+	total.coalesced += current.coalesced;
+	total.repeated += current.repeated;
+	total.sent += current.sent;
+	current = Stats();
+}
+
+
+void OrderBuffer::ForgetUnit(int unitId)
+{
+	std::map<int, std::vector<int> >::iterator it = pendingByUnit.find(unitId);
+	if (it != pendingByUnit.end()) {
+		BOOST_FOREACH(int i, it->second) {
+			pending[i].dropped = true;
+		}
+		pendingByUnit.erase(it);
+	}
+
+	lastQueueOrder.erase(unitId);
+	std::map<std::pair<int, int>, float>::iterator first
+		= lastState.lower_bound(std::make_pair(unitId, INT_MIN));
+	std::map<std::pair<int, int>, float>::iterator last
+		= lastState.lower_bound(std::make_pair(unitId + 1, INT_MIN));
+	lastState.erase(first, last);
+}
+
+
+std::ostream& operator<<(std::ostream& os, const OrderBuffer::Stats& s)
+{
+	return os << s.given << " given, " << s.sent << " sent, "
+		<< s.coalesced << " coalesced, " << s.repeated << " repeats";
+}
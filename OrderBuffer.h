@@ -0,0 +1,68 @@
+#pragma once
+
+#include <map>
+#include <ostream>
+#include <vector>
+#include <utility>
+
+#include "ExternalAI/IAICallback.h"
+
+/// all orders of the AI go through here and are given once per frame
+///
+/// Orders are kept until Flush. A new order which replaces the unit's
+/// command queue drops the orders given to that unit earlier in the same
+/// frame, and state orders (fire state, repeat...) drop older ones of the
+/// same kind. At flush, orders the unit is already following are not sent
+/// again: state orders which don't change the state, and queue orders
+/// equal to the last one given if the unit still has it at the front of
+/// its queue.
+class OrderBuffer
+{
+public:
+	OrderBuffer();
+
+	struct Stats {
+		int given; //<! orders passed to GiveOrder
+		int coalesced; //<! dropped because of a later order in the same frame
+		int repeated; //<! dropped because the unit already follows them
+		int sent; //<! orders given to the engine
+		Stats():given(0), coalesced(0), repeated(0), sent(0) {}
+	};
+
+	void GiveOrder(int unitId, const Command& c);
+	/// give pending orders to the engine, in the order they were given
+	void Flush(IAICallback* cb);
+	/// close the frame's stats, they cover every flush since the last call
+	void EndFrame();
+	/// forget everything about the unit, its id may be reused
+	void ForgetUnit(int unitId);
+
+	const Stats& LastFrameStats() const { return lastFrame; }
+	const Stats& TotalStats() const { return total; }
+
+protected:
+	struct Order {
+		int unitId;
+		Command command;
+		bool dropped;
+		Order(int u, const Command& c):unitId(u), command(c), dropped(false) {}
+	};
+
+	std::vector<Order> pending;
+	std::map<int, std::vector<int> > pendingByUnit; //<! unit id -> indices into pending
+
+	std::map<int, Command> lastQueueOrder; //<! last queue replacing order per unit
+	std::map<std::pair<int, int>, float> lastState; //<! (unit, command id) -> value
+
+	Stats current; //<! since the last EndFrame
+	Stats lastFrame;
+	Stats total;
+
+	static bool IsQueueOrder(const Command& c);
+	static bool IsStateOrder(const Command& c);
+	static bool SameOrder(const Command& a, const Command& b);
+	bool IsRepeat(IAICallback* cb, const Order& o);
+	void Sent(const Order& o);
+};
+
+std::ostream& operator<<(std::ostream& os, const OrderBuffer::Stats& s);
@@ -0,0 +1,144 @@
+#include <cassert>
+
+#include "ExternalAI/IAICallback.h"
+
+#include "Log.h"
+#include "HeightMap.h"
+#include "MapCache.h"
+#include "PassabilityGrid.h"
+
+
+const int PassabilityGrid::CELL_SIZE = CELL_SQUARES*SQUARE_SIZE;
+
+
+PassabilityGrid::PassabilityGrid():
+		w(0), h(0), componentCount(0)
+{
+}
+
+
+void PassabilityGrid::Init(const HeightMap& heightmap, float maxGradient)
+{
+	// the slope mip level whose blocks are our cells
+	int level = 0;
+	while ((1 << level) < CELL_SQUARES)
+		++level;
+	assert((1 << level) == CELL_SQUARES);
+
+	w = heightmap.MipWidth(level);
+	h = heightmap.MipHeight(level);
+	blocked.assign(w*h, 0);
+
+	int blockedCount = 0;
+	for (int cz = 0; cz < h; ++cz) {
+		for (int cx = 0; cx < w; ++cx) {
+			if (heightmap.GetMaxSlope(level, cx, cz) > maxGradient) {
+				blocked[cx + cz*w] = 1;
+				++blockedCount;
+			}
+		}
+	}
+
+	LabelComponents();
+
+	LOG_INFO << "passability grid " << w << "x" << h << ", "
+		<< blockedCount << " cells blocked, "
+		<< componentCount << " components" << std::endl;
+}
+
+
+static const int dx[8] = { 1, -1, 0, 0, 1, 1, -1, -1 };
+static const int dz[8] = { 0, 0, 1, -1, 1, -1, 1, -1 };
+
+/// flood fill with the moves paths use: 8 directions, no cutting corners
+void PassabilityGrid::LabelComponents()
+{
+	component.assign(w*h, NO_COMPONENT);
+	componentCount = 0;
+
+	std::vector<int> stack;
+	for (int start = 0; start < w*h; ++start) {
+		if (blocked[start] || component[start] != NO_COMPONENT)
+			continue;
+		int label = componentCount++;
+		component[start] = label;
+		stack.push_back(start);
+
+		while (!stack.empty()) {
+			int cell = stack.back();
+			stack.pop_back();
+			int x = cell % w, z = cell / w;
+			for (int d = 0; d < 8; ++d) {
+				int nx = x + dx[d], nz = z + dz[d];
+				if (!IsPassable(nx, nz))
+					continue;
+				if (d >= 4 && (!IsPassable(nx, z) || !IsPassable(x, nz)))
+					continue;
+				int next = nx + nz*w;
+				if (component[next] != NO_COMPONENT)
+					continue;
+				component[next] = label;
+				stack.push_back(next);
+			}
+		}
+	}
+}
+
+
+bool PassabilityGrid::SnapToPassable(int& x, int& z) const
+{
+	if (IsPassable(x, z))
+		return true;
+	for (int d = 0; d < 8; ++d) {
+		if (IsPassable(x + dx[d], z + dz[d])) {
+			x += dx[d];
+			z += dz[d];
+			return true;
+		}
+	}
+	return false;
+}
+
+int PassabilityGrid::Component(const float3& pos) const
+{
+	if (!IsValid())
+		return NO_COMPONENT;
+	int x = CellX(pos.x), z = CellZ(pos.z);
+	if (!SnapToPassable(x, z))
+		return NO_COMPONENT;
+	return component[x + z*w];
+}
+
+bool PassabilityGrid::IsReachable(const float3& from, const float3& to) const
+{
+	int a = Component(from);
+	return a != NO_COMPONENT && a == Component(to);
+}
+
+
+float3 PassabilityGrid::CellCenter(int x, int z) const
+{
+	return float3((x + 0.5f)*CELL_SIZE, 0, (z + 0.5f)*CELL_SIZE);
+}
+
+
+void PassabilityGrid::Write(MapCacheWriter& out) const
+{
+	out.Write((boost::int32_t)w);
+	out.Write((boost::int32_t)h);
+	out.Write((boost::int32_t)componentCount);
+	out.WriteVector(blocked);
+	out.WriteVector(component);
+}
+
+bool PassabilityGrid::Read(MapCacheReader& in)
+{
+	boost::int32_t rw, rh, count;
+	if (!in.Read(rw) || !in.Read(rh) || !in.Read(count)
+			|| !in.ReadVector(blocked) || !in.ReadVector(component))
+		return false;
+	w = rw;
+	h = rh;
+	componentCount = count;
+	return (int)blocked.size() == w*h && (int)component.size() == w*h;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include "float3.h"
+
+class HeightMap;
+class MapCacheReader;
+class MapCacheWriter;
+
+/// coarse grid of cells marked passable or blocked by terrain slope
+///
+/// Each cell covers CELL_SQUARES x CELL_SQUARES heightmap squares and is
+/// blocked when the max slope of its squares (see HeightMap) is above the
+/// gradient limit (height difference per elmo). Passable cells
+/// are labelled by connected component, so checking whether one point can
+/// be reached from another is a label compare.
+class PassabilityGrid
+{
+public:
+	PassabilityGrid();
+
+	static const int CELL_SQUARES = 4; //<! must be a power of two
+	static const int CELL_SIZE; //<! in elmos
+
+	void Init(const HeightMap& heightmap, float maxGradient);
+
+	void Write(MapCacheWriter& out) const;
+	bool Read(MapCacheReader& in);
+
+	int w, h; //<! in cells
+
+	bool IsValid() const { return !blocked.empty(); }
+	bool InBounds(int x, int z) const { return x >= 0 && z >= 0 && x < w && z < h; }
+	bool IsPassable(int x, int z) const { return InBounds(x, z) && !blocked[x + z*w]; }
+	int CellX(float x) const { return std::max(0, std::min(w-1, (int)(x / CELL_SIZE))); }
+	int CellZ(float z) const { return std::max(0, std::min(h-1, (int)(z / CELL_SIZE))); }
+	float3 CellCenter(int x, int z) const;
+
+	/// moves (x, z) to a passable neighbour if it's blocked, false if there's none
+	bool SnapToPassable(int& x, int& z) const;
+
+	static const int NO_COMPONENT = -1;
+	/// component label of the cell at pos (snapped), NO_COMPONENT if blocked
+	int Component(const float3& pos) const;
+	bool IsReachable(const float3& from, const float3& to) const;
+	int ComponentCount() const { return componentCount; }
+
+protected:
+	std::vector<unsigned char> blocked;
+	std::vector<int> component;
+	int componentCount;
+
+	void LabelComponents();
+};
@@ -0,0 +1,114 @@
+#include "PathCache.h"
+
+
+PathCache::PathCache():
+		capacity(4096)
+{
+}
+
+
+PathCache::Key PathCache::MakeKey(int sx, int sz, int ex, int ez, int pathType, Metric metric)
+{
+	// 12 bits per coordinate covers maps up to 4096 cells wide
+	return ((Key)metric << 60) | ((Key)(pathType & 0xfff) << 48)
+		| ((Key)(sx & 0xfff) << 36) | ((Key)(sz & 0xfff) << 24)
+		| ((Key)(ex & 0xfff) << 12) | (Key)(ez & 0xfff);
+}
+
+
+PathCache::Key PathCache::KeyOf(const float3& start, const float3& end, int pathType, Metric metric)
+{
+	return MakeKey(CellCoord(start.x), CellCoord(start.z),
+			CellCoord(end.x), CellCoord(end.z), pathType, metric);
+}
+
+
+bool PathCache::Lookup(const float3& start, const float3& end, int pathType, Metric metric, float& value)
+{
+	Key key = KeyOf(start, end, pathType, metric);
+	EntryMap::iterator it = entries.find(key);
+	if (it == entries.end()) {
+		++stats.misses;
+		return false;
+	}
+
+	// move to front
+	lru.splice(lru.begin(), lru, it->second);
+	value = it->second->value;
+	++stats.hits;
+	return true;
+}
+
+void PathCache::Store(const float3& start, const float3& end, int pathType, Metric metric, float value)
+{
+	int sx = CellCoord(start.x), sz = CellCoord(start.z);
+	int ex = CellCoord(end.x), ez = CellCoord(end.z);
+	Key key = MakeKey(sx, sz, ex, ez, pathType, metric);
+
+	EntryMap::iterator it = entries.find(key);
+	if (value < 0) {
+		// an older length for the cells is stale now
+		if (it != entries.end()) {
+			lru.erase(it->second);
+			entries.erase(it);
+		}
+		return;
+	}
+	if (it != entries.end()) {
+		it->second->value = value;
+		lru.splice(lru.begin(), lru, it->second);
+		return;
+	}
+
+	while (!lru.empty() && lru.size() >= capacity) {
+		entries.erase(lru.back().key);
+		lru.pop_back();
+		++stats.evictions;
+	}
+
+	Entry e;
+	e.key = key;
+	e.value = value;
+	e.minx = std::min(sx, ex);
+	e.maxx = std::max(sx, ex);
+	e.minz = std::min(sz, ez);
+	e.maxz = std::max(sz, ez);
+	lru.push_front(e);
+	entries[key] = lru.begin();
+}
+
+
+void PathCache::Invalidate(const float3& pos, float radius)
+{
+	// paths may bend outside the box of their ends, pad it by a cell
+	int r = (int)(radius / CELL_SIZE) + 1;
+	int cx = CellCoord(pos.x), cz = CellCoord(pos.z);
+
+	EntryList::iterator it = lru.begin();
+	while (it != lru.end()) {
+		if (cx >= it->minx - r && cx <= it->maxx + r
+				&& cz >= it->minz - r && cz <= it->maxz + r) {
+			entries.erase(it->key);
+			it = lru.erase(it);
+			++stats.invalidations;
+		} else {
+			++it;
+		}
+	}
+}
+
+void PathCache::clear()
+{
+	lru.clear();
+	entries.clear();
+}
+
+
+std::ostream& operator<<(std::ostream& os, const PathCache::Stats& s)
+{
+	int total = s.hits + s.misses;
+	os << "hits " << s.hits << " misses " << s.misses
+		<< " (" << (total ? 100*s.hits/total : 0) << "% hit)"
+		<< " evictions " << s.evictions << " invalidated " << s.invalidations;
+	return os;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <algorithm>
+#include <list>
+#include <ostream>
+#include <boost/cstdint.hpp>
+#include <boost/unordered_map.hpp>
+
+#include "float3.h"
+
+/// cache of path lengths keyed by coarse start and end cells
+///
+/// Start and end points are quantized to CELL_SIZE cells, so queries from
+/// slightly different points near a unit share one entry. The least
+/// recently used entries are dropped once capacity is reached. A structure
+/// appearing or disappearing invalidates the entries whose start-end box
+/// lies near it. "No path" results are not kept: they often come from a
+/// start point on a blocked square and would stick to the whole cell.
+class PathCache
+{
+public:
+	PathCache();
+
+	/// size of a cell in elmos
+	static const int CELL_SIZE = 64;
+
+	/// what was measured along the path
+	enum Metric {
+		PATH_LENGTH,      //<! IAICallback::GetPathLength
+		SQ_WAYPOINT_SUM,  //<! sum of squared waypoint distances, PathRequestQueue
+		WAYPOINT_SUM      //<! sum of waypoint distances, PathRequestQueue
+	};
+
+	typedef boost::uint64_t Key;
+	static Key KeyOf(const float3& start, const float3& end, int pathType, Metric metric);
+
+	size_t capacity;
+
+	bool Lookup(const float3& start, const float3& end, int pathType, Metric metric, float& value);
+	/// negative values (no path) aren't stored, they drop the entry instead
+	void Store(const float3& start, const float3& end, int pathType, Metric metric, float value);
+
+	/// drop entries whose paths may pass within radius of pos
+	void Invalidate(const float3& pos, float radius);
+	void clear();
+
+	size_t size() const { return lru.size(); }
+
+	struct Stats {
+		int hits;
+		int misses;
+		int evictions;
+		int invalidations;
+		Stats():hits(0), misses(0), evictions(0), invalidations(0) {}
+	};
+	const Stats& GetStats() const { return stats; }
+
+protected:
+	struct Entry {
+		Key key;
+		float value;
+		// cell bounds of start and end
+		int minx, minz, maxx, maxz;
+	};
+
+	typedef std::list<Entry> EntryList; //<! most recently used first
+	typedef boost::unordered_map<Key, EntryList::iterator> EntryMap;
+
+	EntryList lru;
+	EntryMap entries;
+	Stats stats;
+
+	static int CellCoord(float x) { return std::max(0, (int)(x / CELL_SIZE)); }
+	static Key MakeKey(int sx, int sz, int ex, int ez, int pathType, Metric metric);
+};
+
+std::ostream& operator<<(std::ostream& os, const PathCache::Stats& s);
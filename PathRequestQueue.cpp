@@ -0,0 +1,135 @@
+#include "ExternalAI/IAICallback.h"
+
+#include "Log.h"
+#include "Clock.h"
+#include "PathRequestQueue.h"
+
+
+PathRequestQueue::PathRequestQueue(IAICallback* c, PathCache& pc):
+		budget(1000), cb(c), cache(pc)
+{
+}
+
+PathRequestQueue::~PathRequestQueue()
+{
+	clear();
+}
+
+
+void PathRequestQueue::Request(int pathType, const float3& start, const float3& end,
+		PathCache::Metric metric, const Callback& callback)
+{
+	float cached;
+	if (cache.Lookup(start, end, pathType, metric, cached)) {
+		callback(cached);
+		return;
+	}
+
+	PathCache::Key key = PathCache::KeyOf(start, end, pathType, metric);
+	RequestMap::iterator it = inFlight.find(key);
+	if (it != inFlight.end()) {
+		it->second->callbacks.push_back(callback);
+		return;
+	}
+
+	PathRequest r;
+	r.key = key;
+	r.pathType = pathType;
+	r.start = start;
+	r.end = end;
+	r.metric = metric;
+	r.callbacks.push_back(callback);
+	r.pathId = -1;
+	r.total = 0;
+	requests.push_back(r);
+	inFlight[key] = --requests.end();
+}
+
+
+void PathRequestQueue::Run(int frame)
+{
+	boost::int64_t deadline = GetMicroseconds() + budget;
+
+	// each request gets at most one turn per frame, callbacks may add more
+	size_t count = requests.size();
+	RequestList::iterator it = requests.begin();
+	for (size_t i = 0; i < count && it != requests.end(); ++i) {
+		StepResult result = Step(*it, deadline);
+		if (result == STEP_DONE) {
+			RequestList::iterator done = it++;
+			Finish(done, done->total);
+		} else if (result == STEP_BUDGET) {
+			break;
+		} else {
+			++it;
+		}
+	}
+}
+
+static float Measure(PathCache::Metric metric, const float3& a, const float3& b)
+{
+	if (metric == PathCache::SQ_WAYPOINT_SUM)
+		return a.SqDistance2D(b);
+	return a.distance2D(b);
+}
+
+PathRequestQueue::StepResult PathRequestQueue::Step(PathRequest& r, boost::int64_t deadline)
+{
+	if (r.pathId < 0) {
+		r.pathId = cb->InitPath(r.start, r.end, r.pathType);
+		r.prev = r.start;
+	}
+
+	for (int steps = 0; ; ++steps) {
+		// checking the clock is not free, do it every few waypoints
+		if ((steps & 7) == 7 && GetMicroseconds() > deadline)
+			return STEP_BUDGET;
+
+		float3 cur = cb->GetNextWaypoint(r.pathId);
+		if (cur.y == -2) // not ready yet
+			return STEP_WAIT;
+		if (r.prev == cur) // end of path
+			return STEP_DONE;
+
+		// y == -1 means no path or end of path
+		if (cur.y < 0) {
+			if (cur.x < 0 || cur.z < 0) { // error
+				r.total = -1;
+			} else {
+				// last waypoint reached
+				r.total += Measure(r.metric, cur, r.end);
+			}
+			return STEP_DONE;
+		}
+
+		r.total += Measure(r.metric, r.prev, cur);
+		r.prev = cur;
+	}
+}
+
+void PathRequestQueue::Finish(RequestList::iterator it, float result)
+{
+	if (it->pathId >= 0)
+		cb->FreePath(it->pathId);
+	cache.Store(it->start, it->end, it->pathType, it->metric, result);
+
+	// callbacks may make new requests, take this one out first
+	std::vector<Callback> callbacks;
+	callbacks.swap(it->callbacks);
+	inFlight.erase(it->key);
+	requests.erase(it);
+
+	for (size_t i = 0; i < callbacks.size(); ++i)
+		callbacks[i](result);
+}
+
+
+void PathRequestQueue::clear()
+{
+	for (RequestList::iterator it = requests.begin(); it != requests.end(); ++it) {
+		if (it->pathId >= 0)
+			cb->FreePath(it->pathId);
+	}
+	requests.clear();
+	inFlight.clear();
+}
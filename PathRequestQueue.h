@@ -0,0 +1,66 @@
+#pragma once
+
+#include <list>
+#include <vector>
+#include <boost/function.hpp>
+#include <boost/unordered_map.hpp>
+
+#include "float3.h"
+#include "PathCache.h"
+
+class IAICallback;
+
+/// engine path queries answered over several frames
+///
+/// Requests walk the waypoints of an engine path and sum up their lengths
+/// (see PathCache::Metric). Run advances them until its time budget is
+/// used up; a path the engine hasn't finished yet ("try again" waypoint)
+/// is left for the next frame instead of being polled in a loop. Requests
+/// for the same cells, path type and metric share one engine path, and
+/// results go into the PathCache, which answers repeated requests at once.
+class PathRequestQueue
+{
+public:
+	PathRequestQueue(IAICallback* cb, PathCache& cache);
+	~PathRequestQueue();
+
+	/// called with the result, -1 if there's no path
+	typedef boost::function<void (float)> Callback;
+
+	int budget; //<! microseconds per Run
+
+	/// callback may be called before this returns if the result is cached
+	void Request(int pathType, const float3& start, const float3& end,
+			PathCache::Metric metric, const Callback& callback);
+	void Run(int frame);
+
+	size_t size() const { return requests.size(); }
+	/// drop all requests without calling their callbacks
+	void clear();
+
+protected:
+	struct PathRequest {
+		PathCache::Key key;
+		int pathType;
+		float3 start, end;
+		PathCache::Metric metric;
+		std::vector<Callback> callbacks;
+
+		// progress
+		int pathId; //<! -1 until the engine path is started
+		float3 prev;
+		float total;
+	};
+
+	typedef std::list<PathRequest> RequestList;
+	typedef boost::unordered_map<PathCache::Key, RequestList::iterator> RequestMap;
+
+	IAICallback* cb;
+	PathCache& cache;
+	RequestList requests; //<! oldest first
+	RequestMap inFlight;
+
+	enum StepResult { STEP_DONE, STEP_WAIT, STEP_BUDGET };
+	StepResult Step(PathRequest& r, boost::int64_t deadline);
+	void Finish(RequestList::iterator it, float result);
+};
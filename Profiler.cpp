@@ -0,0 +1,188 @@
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <cassert>
+#include <boost/foreach.hpp>
+
+#include "Log.h"
+#include "Clock.h"
+#include "Profiler.h"
+
+
+Profiler* Profiler::current = 0;
+
+
+Profiler::Profiler():
+		currentFrame(-1), written(0)
+{
+	epoch = GetMicroseconds();
+	frameStart = epoch;
+}
+
+
+int Profiler::RegisterZone(const char* name)
+{
+	return RegisterZone(std::string(name));
+}
+
+int Profiler::RegisterZone(const std::string& name)
+{
+	std::map<std::string, int>& zoneIds = ZoneIds();
+	std::map<std::string, int>::iterator it = zoneIds.find(name);
+	if (it != zoneIds.end())
+		return it->second;
+
+	int id = ZoneNames().size();
+	ZoneNames().push_back(name);
+	zoneIds.insert(std::make_pair(name, id));
+	return id;
+}
+
+// function statics, zones are registered from static initializers too
+std::vector<std::string>& Profiler::ZoneNames()
+{
+	static std::vector<std::string> names;
+	return names;
+}
+
+std::map<std::string, int>& Profiler::ZoneIds()
+{
+	static std::map<std::string, int> ids;
+	return ids;
+}
+
+
+void Profiler::Enter(int zone)
+{
+	Event e;
+	e.zone = zone;
+	e.depth = open.size();
+	e.start = GetMicroseconds();
+	e.duration = 0;
+	open.push_back(events.size());
+	events.push_back(e);
+}
+
+void Profiler::Leave(int zone)
+{
+	assert(!open.empty());
+	Event& e = events[open.back()];
+	assert(e.zone == zone);
+	open.pop_back();
+	e.duration = GetMicroseconds() - e.start;
+
+	// zones registered after this profiler was created
+	while ((int)samples.size() <= zone) {
+		ZoneSample s = { (int)samples.size(), 0, 0 };
+		samples.push_back(s);
+	}
+	ZoneSample& s = samples[zone];
+	if (s.calls == 0)
+		touched.push_back(zone);
+	++s.calls;
+	s.total += e.duration;
+}
+
+
+void Profiler::StartFrame(int frame)
+{
+	currentFrame = frame;
+	frameStart = GetMicroseconds();
+}
+
+void Profiler::EndFrame()
+{
+	// zones still open belong to the next frame
+	if (!open.empty())
+		return;
+
+	FrameRecord& rec = history[written % HISTORY];
+	rec.frame = currentFrame;
+	rec.start = frameStart;
+	rec.duration = GetMicroseconds() - frameStart;
+	rec.zones.clear();
+	BOOST_FOREACH(int z, touched) {
+		rec.zones.push_back(samples[z]);
+		samples[z].calls = 0;
+		samples[z].total = 0;
+	}
+	rec.events.swap(events);
+	++written;
+
+	touched.clear();
+	events.clear();
+}
+
+
+void Profiler::LogReport()
+{
+	const std::vector<std::string>& zoneNames = ZoneNames();
+	int count = std::min(written, HISTORY);
+	// per zone time in each frame it ran in
+	std::vector<std::vector<boost::int64_t> > perFrame(zoneNames.size());
+	std::vector<int> calls(zoneNames.size(), 0);
+	for (int i = 0; i < count; ++i) {
+		BOOST_FOREACH(const ZoneSample& s, history[i].zones) {
+			perFrame[s.zone].push_back(s.total);
+			calls[s.zone] += s.calls;
+		}
+	}
+
+	LOG_INFO << "profile of the last " << count << " frames (us per frame: min mean p99 max, calls per frame)" << std::endl;
+	for (size_t z = 0; z < zoneNames.size(); ++z) {
+		std::vector<boost::int64_t>& v = perFrame[z];
+		if (v.empty())
+			continue;
+		std::sort(v.begin(), v.end());
+		boost::int64_t sum = 0;
+		BOOST_FOREACH(boost::int64_t t, v) {
+			sum += t;
+		}
+		size_t p99 = std::max((size_t)1, (size_t)(v.size()*0.99 + 0.5)) - 1;
+		LOG_INFO << "  " << std::left << std::setw(40) << zoneNames[z] << std::right
+			<< " " << v.front() << " " << sum / (boost::int64_t)v.size()
+			<< " " << v[p99] << " " << v.back()
+			<< " " << (float)calls[z] / v.size() << std::endl;
+	}
+}
+
+
+static void WriteJSONString(std::ostream& out, const std::string& s)
+{
+	out << '"';
+	BOOST_FOREACH(char c, s) {
+		if (c == '"' || c == '\\')
+			out << '\\';
+		out << c;
+	}
+	out << '"';
+}
+
+bool Profiler::WriteChromeTrace(const std::string& fileName)
+{
+	std::ofstream out(fileName.c_str());
+	if (!out) {
+		LOG_ERROR << "can't write profiler trace to " << fileName << std::endl;
+		return false;
+	}
+
+	// trace event format, complete events ("X") with microsecond timestamps
+	out << "{\"traceEvents\":[\n";
+	bool first = true;
+	int count = std::min(written, HISTORY);
+	for (int i = written - count; i < written; ++i) {
+		const FrameRecord& rec = history[i % HISTORY];
+		out << (first ? "" : ",\n") << "{\"name\":\"frame " << rec.frame
+			<< "\",\"ph\":\"X\",\"pid\":0,\"tid\":0,\"ts\":" << rec.start - epoch
+			<< ",\"dur\":" << rec.duration << "}";
+		first = false;
+		BOOST_FOREACH(const Event& e, rec.events) {
+			out << ",\n{\"name\":";
+			WriteJSONString(out, ZoneNames()[e.zone]);
+			out << ",\"ph\":\"X\",\"pid\":0,\"tid\":0,\"ts\":" << e.start - epoch
+				<< ",\"dur\":" << e.duration << ",\"args\":{\"depth\":" << e.depth << "}}";
+		}
+	}
+	out << "\n]}\n";
+	return true;
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+#include <boost/cstdint.hpp>
+
+/// hierarchical frame profiler, one per AI instance
+///
+/// Code is measured by PROFILE_ZONE, which times the enclosing scope in
+/// the profiler made current by a ProfilerScope; without one it does
+/// nothing. Zones nest, the depth is recorded for the trace. A frame
+/// record spans StartFrame to EndFrame (the AI's Update) and also holds
+/// the zones run since the previous one, e.g. in engine events; the last
+/// HISTORY records are kept in a ring buffer for the report and for the
+/// Chrome trace (chrome://tracing, about:tracing) export.
+/// Zones must only be entered from the engine thread.
+class Profiler
+{
+public:
+	Profiler();
+
+	static const int HISTORY = 512; //<! frame records kept
+
+	/// zone ids are shared by all profilers, zones with the same name are merged
+	static int RegisterZone(const char* name);
+	static int RegisterZone(const std::string& name);
+
+	/// profiler PROFILE_ZONE records into, see ProfilerScope
+	static Profiler* current;
+
+	void Enter(int zone);
+	void Leave(int zone);
+
+	void StartFrame(int frame);
+	/// close the frame record
+	void EndFrame();
+
+	/// per zone min/mean/p99/max of time per frame, in microseconds
+	void LogReport();
+	bool WriteChromeTrace(const std::string& fileName);
+
+protected:
+	struct ZoneSample {
+		int zone;
+		int calls;
+		boost::int64_t total;
+	};
+
+	struct Event {
+		int zone;
+		int depth;
+		boost::int64_t start;
+		boost::int64_t duration;
+	};
+
+	struct FrameRecord {
+		int frame;
+		boost::int64_t start;
+		boost::int64_t duration;
+		std::vector<ZoneSample> zones;
+		std::vector<Event> events;
+	};
+
+	static std::vector<std::string>& ZoneNames();
+	static std::map<std::string, int>& ZoneIds();
+
+	// current frame
+	int currentFrame;
+	boost::int64_t frameStart;
+	std::vector<ZoneSample> samples; //<! indexed by zone
+	std::vector<int> touched; //<! zones in current with calls > 0
+	std::vector<Event> events;
+	std::vector<int> open; //<! indices into events of entered zones
+
+	// single writer, no locking needed
+	FrameRecord history[HISTORY];
+	int written; //<! records written so far, next goes to written % HISTORY
+
+	boost::int64_t epoch;
+};
+
+
+/// times a scope in the current profiler, see PROFILE_ZONE
+class ProfileZone
+{
+public:
+	ProfileZone(int z):profiler(Profiler::current), zone(z) { if (profiler) profiler->Enter(zone); }
+	~ProfileZone() { if (profiler) profiler->Leave(zone); }
+protected:
+	Profiler* profiler;
+	int zone;
+};
+
+/// makes p the current profiler for a scope, e.g. a call from the engine
+class ProfilerScope
+{
+public:
+	ProfilerScope(Profiler& p):previous(Profiler::current) { Profiler::current = &p; }
+	~ProfilerScope() { Profiler::current = previous; }
+protected:
+	Profiler* previous;
+};
+
+/// one frame record over a scope
+class ProfileFrame
+{
+public:
+	ProfileFrame(Profiler& p, int frame):profiler(p) { profiler.StartFrame(frame); }
+	~ProfileFrame() { profiler.EndFrame(); }
+protected:
+	Profiler& profiler;
+};
+
+
+#define PROFILE_ZONE_CAT2(a, b) a##b
+#define PROFILE_ZONE_CAT(a, b) PROFILE_ZONE_CAT2(a, b)
+/// profile the enclosing scope as zone name (a string literal)
+#define PROFILE_ZONE(name) \
+	static const int PROFILE_ZONE_CAT(profileZoneId, __LINE__) = Profiler::RegisterZone(name); \
+	ProfileZone PROFILE_ZONE_CAT(profileZone, __LINE__)(PROFILE_ZONE_CAT(profileZoneId, __LINE__))
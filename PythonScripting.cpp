@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <cassert>
 #include <string>
 
 #if defined(_DEBUG)
@@ -17,6 +19,9 @@
 #include <boost/filesystem.hpp>
 
 #include "BaczekKPAI.h"
+#include "Clock.h"
+#include "InfluenceMap.h"
+#include "WorldSnapshot.h"
 #include "Log.h"
 #include "PythonScripting.h"
 
@@ -26,6 +31,7 @@ using namespace boost::python;
 // static members
 
 PythonScripting::ai_map_t PythonScripting::ai_map;
+int PythonScripting::configVersion = 0;
 
 void PythonScripting::RegisterAI(int teamId, BaczekKPAI *ai)
 {
@@ -54,6 +60,15 @@ static bool hasattr(boost::python::object obj, std::string const &attrName) {
      return PyObject_HasAttrString(obj.ptr(), attrName.c_str());
 }
 
+/// read-only memoryview of memory owned by C++
+template<typename T>
+static object MakeView(const std::vector<T>& v)
+{
+	Py_buffer buf;
+	PyBuffer_FillInfo(&buf, NULL, (void*)&v[0], v.size()*sizeof(T), 1, PyBUF_CONTIG_RO);
+	return object(handle<>(PyMemoryView_FromBuffer(&buf)));
+}
+
 /////////////////////////////////////
 // module
 
@@ -66,6 +81,11 @@ namespace PythonFunctions
 			return;
 		ai->cb->SendTextMsg(s.c_str(), 0);
 	}
+
+	void ConfigChanged()
+	{
+		++PythonScripting::configVersion;
+	}
 };
 
 static void IndexError() { PyErr_SetString(PyExc_IndexError, "Index out of range"); }
@@ -122,6 +142,7 @@ BOOST_PYTHON_MODULE(pykpai)
 		.def("__delitem__", &std_item<std::vector<float3>, float3>::del)
 		;
 	def("SendTextMessage", PythonFunctions::SendTextMessage);
+	def("ConfigChanged", PythonFunctions::ConfigChanged);
 	
 	// export constants
 	scope().attr("GAME_SPEED") = GAME_SPEED;
@@ -136,6 +157,12 @@ BOOST_PYTHON_MODULE(pykpai)
 PythonScripting::PythonScripting(int teamId, std::string datadir)
 {
 	this->teamId = teamId;
+	hasWorldFrame = false;
+	currentFrame = 0;
+	hookBudget = 10000;
+	maxOverruns = 3;
+	demotedPeriod = GAME_SPEED;
+	hasBuildSpotPriorities = false;
 
 	PyImport_AppendInittab( "pykpai", &initpykpai );
 	Py_Initialize();
@@ -145,17 +172,17 @@ PythonScripting::PythonScripting(int teamId, std::string datadir)
 
 	object sys = import("sys");
 	std::string version = extract<std::string>(sys.attr("version"));
-	ailog->info() << "Python loaded.\n";
-	ailog->info() << version << std::endl;
+	LOG_INFO << "Python loaded.\n";
+	LOG_INFO << version << std::endl;
 
 	dict main_dict = extract<dict>(main_namespace);
 	object file_func = main_dict["__builtins__"].attr("file");
 
-	ailog->info() << "py: setting sys.stdout..." << std::endl;
+	LOG_INFO << "py: setting sys.stdout..." << std::endl;
 	object file_out = file_func(str(datadir+"/pyout.txt"), "w");
 	sys.attr("stdout") = file_out;
 
-	ailog->info() << "py: setting sys.stderr..." << std::endl;
+	LOG_INFO << "py: setting sys.stderr..." << std::endl;
 	object file_err = file_func(str(datadir+"/pyerr.txt"), "w");
 	sys.attr("stderr") = file_err;
 
@@ -167,28 +194,163 @@ PythonScripting::PythonScripting(int teamId, std::string datadir)
 	} catch (error_already_set &) {
 		PyErr_Print();
 	}
+	// checked once, it's called every frame
+	hasWorldFrame = hasattr(init, "world_frame");
+	hasBuildSpotPriorities = hasattr(init, "get_build_spot_priorities");
 }
 
 PythonScripting::~PythonScripting()
 {
 }
 
-#define PY_FUNC_SKELETON(NAME, ...) \
+/////////////////////////////////////
+// watchdog
+
+PythonScripting::HookStats::HookStats():
+		calls(0), overruns(0), strikes(0), interrupts(0), skipped(0), total(0), max(0),
+		period(1), lastFrame(-1)
+{
+	std::fill(histogram, histogram+BUCKETS, 0);
+}
+
+// python runs on one thread only, so these can be shared by all AIs
+static boost::int64_t watchdogDeadline;
+static bool watchdogFired;
+
+/// trace function, called by the interpreter on every line and call
+static int WatchdogTrace(PyObject*, struct _frame*, int, PyObject*)
+{
+	if (GetMicroseconds() < watchdogDeadline)
+		return 0;
+	watchdogFired = true;
+	// keeps firing while the script unwinds, so catching it doesn't help
+	PyErr_SetString(PyExc_RuntimeError, "AI hook ran over its time budget");
+	return -1;
+}
+
+/// returns false if a demoted hook should be skipped this time
+///
+/// Only skippable (fire-and-forget) hooks are ever demoted or interrupted
+/// by the watchdog. Hooks whose return value is used always run to the
+/// end, cutting them short would silently turn their result into the
+/// default; overrunning the budget only gets them logged.
+bool PythonScripting::BeginHook(HookStats& hook, bool skippable)
+{
+	if (!skippable)
+		return true;
+	if (hook.period > 1 && currentFrame - hook.lastFrame < hook.period) {
+		++hook.skipped;
+		return false;
+	}
+	hook.lastFrame = currentFrame;
+
+	if (hookBudget > 0) {
+		watchdogDeadline = GetMicroseconds() + hookBudget;
+		watchdogFired = false;
+		PyEval_SetTrace(WatchdogTrace, NULL);
+	}
+	return true;
+}
+
+void PythonScripting::EndHook(const char* name, HookStats& hook, boost::int64_t start, bool skippable)
+{
+	boost::int64_t cost = GetMicroseconds() - start;
+	bool interrupted = false;
+	if (skippable && hookBudget > 0) {
+		PyEval_SetTrace(NULL, NULL);
+		interrupted = watchdogFired;
+	}
+
+	++hook.calls;
+	hook.total += cost;
+	hook.max = std::max(hook.max, cost);
+	int bucket = 0;
+	while (bucket < HookStats::BUCKETS-1 && cost >= (16 << bucket))
+		++bucket;
+	++hook.histogram[bucket];
+
+	if (hookBudget <= 0)
+		return;
+
+	if (cost <= hookBudget) {
+		// each call within budget makes up for one overrun
+		if (hook.strikes > 0 && --hook.strikes == 0 && hook.period > 1) {
+			hook.period = 1;
+			LOG_INFO << "py: " << name << " is back within budget, called every frame again" << std::endl;
+		}
+		return;
+	}
+
+	++hook.overruns;
+	if (!skippable) {
+		// the result is needed, so it's only reported; once, the rest go to debug
+		if (hook.overruns == 1)
+			LOG_INFO << "py: " << name << " took " << cost << "us, over the " << hookBudget << "us budget" << std::endl;
+		else
+			LOG_DEBUG << "py: " << name << " took " << cost << "us, over the " << hookBudget << "us budget" << std::endl;
+		return;
+	}
+
+	++hook.strikes;
+	if (interrupted) {
+		++hook.interrupts;
+		LOG_ERROR << "py: " << name << " interrupted after " << cost << "us" << std::endl;
+	}
+	if (hook.strikes >= maxOverruns && hook.period < demotedPeriod) {
+		hook.period = demotedPeriod;
+		LOG_ERROR << "py: " << name << " overran its budget " << hook.strikes
+			<< " times more than it kept it, demoted to every " << hook.period << " frames" << std::endl;
+	}
+}
+
+void PythonScripting::LogHookStats()
+{
+	LOG_INFO << "python hook stats (budget " << hookBudget << "us), histogram buckets from <16us doubling:" << std::endl;
+	for (hook_map_t::iterator it = hooks.begin(); it != hooks.end(); ++it) {
+		const HookStats& h = it->second;
+		std::ostringstream histogram;
+		for (int i = 0; i < HookStats::BUCKETS; ++i)
+			histogram << " " << h.histogram[i];
+		LOG_INFO << "  " << it->first << ": calls " << h.calls
+			<< " mean " << (h.calls ? h.total / h.calls : 0) << "us"
+			<< " max " << h.max << "us"
+			<< " overruns " << h.overruns
+			<< " strikes " << h.strikes
+			<< " interrupted " << h.interrupts
+			<< " skipped " << h.skipped
+			<< " period " << h.period
+			<< " histogram" << histogram.str() << std::endl;
+	}
+}
+
+
+#define PY_HOOK_SKELETON(SKIPPABLE, NAME, ...) \
 	object ret; \
 	if (hasattr(init, NAME)) { \
-		try { \
-			ret = init.attr(NAME) (__VA_ARGS__); \
-		} catch (error_already_set&) { \
-			PyErr_Print(); \
+		HookStats& hook = hooks[NAME]; \
+		if (BeginHook(hook, SKIPPABLE)) { \
+			boost::int64_t hookStart = GetMicroseconds(); \
+			try { \
+				ret = init.attr(NAME) (__VA_ARGS__); \
+			} catch (error_already_set&) { \
+				PyErr_Print(); \
+			} \
+			EndHook(NAME, hook, hookStart, SKIPPABLE); \
 		} \
 	} else { \
-		ailog->info() << "py: " NAME "(" #__VA_ARGS__ ") not defined" << std::endl; \
+		LOG_INFO << "py: " NAME "(" #__VA_ARGS__ ") not defined" << std::endl; \
 	}
 
+/// fire-and-forget hook, may be demoted or interrupted
+#define PY_FUNC_SKELETON(NAME, ...) PY_HOOK_SKELETON(true, NAME, __VA_ARGS__)
+/// hook whose result is used, always runs to the end
+#define PY_VALUE_SKELETON(NAME, ...) PY_HOOK_SKELETON(false, NAME, __VA_ARGS__)
+
 
 
 void PythonScripting::GameFrame(int framenum)
 {
+	currentFrame = framenum;
 	PY_FUNC_SKELETON("game_frame", teamId, framenum);
 }
 
@@ -200,24 +362,79 @@ void PythonScripting::DumpStatus(int framenum, const std::vector<float3>& geos,
 }
 
 
+void PythonScripting::ExposeWorld(WorldSnapshot& snapshot, InfluenceMap& influence)
+{
+	world["id"] = MakeView(snapshot.id);
+	world["unitdef"] = MakeView(snapshot.unitDef);
+	world["x"] = MakeView(snapshot.x);
+	world["y"] = MakeView(snapshot.y);
+	world["z"] = MakeView(snapshot.z);
+	world["health"] = MakeView(snapshot.health);
+	// column major, influence[x*influence_h + y]
+	world["influence"] = MakeView(influence.map.cells);
+	world["influence_w"] = influence.mapw;
+	world["influence_h"] = influence.maph;
+}
+
+void PythonScripting::WorldFrame(const WorldSnapshot& snapshot)
+{
+	currentFrame = snapshot.frame;
+	world["count"] = snapshot.count;
+	world["friend_count"] = snapshot.friendCount;
+	PY_FUNC_SKELETON("world_frame", teamId, snapshot.frame, world);
+}
+
+
 int PythonScripting::GetBuilderRetreatTimeout(int frameNum)
 {
-	PY_FUNC_SKELETON("get_builder_retreat_timeout", frameNum);
+	PY_VALUE_SKELETON("get_builder_retreat_timeout", frameNum);
 	return extract_default<int, double, int>(ret, frameNum+10*GAME_SPEED);
 }
 
 
 int PythonScripting::GetWantedConstructors(int geospots, int width, int height)
 {
-	PY_FUNC_SKELETON("get_wanted_constructors", geospots, width, height);
+	PY_VALUE_SKELETON("get_wanted_constructors", geospots, width, height);
 	return extract_default<int, double, int>(ret, 4);
 }
 
 
-int PythonScripting::GetBuildSpotPriority(float distance, int influence, int width, int height, int def)
+bool PythonScripting::GetBuildSpotPriorities(const std::vector<float>& distances,
+		const std::vector<int>& influences, int width, int height,
+		std::vector<int>& priorities)
 {
-	PY_FUNC_SKELETON("get_build_spot_priority", distance, influence, width, height);
-	return extract_default<int, double, int>(ret, def);
+	if (!hasBuildSpotPriorities)
+		return false;
+	assert(distances.size() == influences.size());
+
+	list pyDistances, pyInfluences;
+	for (size_t i = 0; i < distances.size(); ++i) {
+		pyDistances.append(distances[i]);
+		pyInfluences.append(influences[i]);
+	}
+
+	PY_VALUE_SKELETON("get_build_spot_priorities", pyDistances, pyInfluences, width, height);
+	if (ret.ptr() == Py_None)
+		return false;
+
+	try {
+		Py_ssize_t n = len(ret);
+		if (n != (Py_ssize_t)distances.size()) {
+			LOG_ERROR << "py: get_build_spot_priorities returned " << n
+				<< " priorities for " << distances.size() << " spots" << std::endl;
+			return false;
+		}
+		priorities.resize(n);
+		for (Py_ssize_t i = 0; i < n; ++i) {
+			object item = ret[i];
+			extract<int> asInt(item);
+			priorities[i] = asInt.check() ? asInt() : (int)extract<double>(item);
+		}
+	} catch (error_already_set&) {
+		PyErr_Print();
+		return false;
+	}
+	return true;
 }
 
 ///////////////////////////////////////////////////////////////
@@ -225,14 +442,14 @@ int PythonScripting::GetBuildSpotPriority(float distance, int influence, int wid
 
 int PythonScripting::GetIntValue(const char* name, int def)
 {
-	PY_FUNC_SKELETON("get_config_value", name);
+	PY_VALUE_SKELETON("get_config_value", name);
 	return extract_default<int, double, int>(ret, def);
 }
 
 
 float PythonScripting::GetFloatValue(const char* name, float def)
 {
-	PY_FUNC_SKELETON("get_config_value", name);
+	PY_VALUE_SKELETON("get_config_value", name);
 	// try to extract as float first, if fails, extract int, if fails again, return default
 	return extract_default<double, int, float>(ret, def);
 }
@@ -240,6 +457,6 @@ float PythonScripting::GetFloatValue(const char* name, float def)
 
 std::string PythonScripting::GetStringValue(const char* name, const std::string& def)
 {
-	PY_FUNC_SKELETON("get_config_value", name);
+	PY_VALUE_SKELETON("get_config_value", name);
 	return extract_default<std::string>(ret, def);
 }
@@ -12,11 +12,15 @@
 #endif
 
 #include <map>
+#include <string>
 #include <boost/python.hpp>
+#include <boost/cstdint.hpp>
 
 namespace bp = boost::python;
 
 class BaczekKPAI;
+class InfluenceMap;
+class WorldSnapshot;
 
 class PythonScripting
 {
@@ -24,13 +28,52 @@ protected:
 	boost::python::object init;
 	int teamId;
 
+	bp::dict world; //<! views of WorldSnapshot and InfluenceMap buffers
+	bool hasWorldFrame;
+	bool hasBuildSpotPriorities;
+
 	typedef std::map<int, BaczekKPAI*> ai_map_t;
 	static ai_map_t ai_map;
 
+	/// timing of one init.py function
+	struct HookStats {
+		static const int BUCKETS = 12;
+
+		int calls;
+		int overruns; //<! calls which took longer than the budget
+		int strikes; //<! overruns not yet made up for by calls within budget
+		int interrupts; //<! calls stopped by the watchdog
+		int skipped; //<! calls left out while demoted
+		boost::int64_t total;
+		boost::int64_t max;
+		int histogram[BUCKETS]; //<! bucket i counts calls under 16<<i us
+		int period; //<! frames between calls, 1 until demoted
+		int lastFrame;
+
+		HookStats();
+	};
+	typedef std::map<std::string, HookStats> hook_map_t;
+	hook_map_t hooks;
+	int currentFrame;
+
+	bool BeginHook(HookStats& hook, bool skippable);
+	void EndHook(const char* name, HookStats& hook, boost::int64_t start, bool skippable);
+
 public:
+	/// watchdog settings, see BeginHook
+	int hookBudget; //<! microseconds per call, 0 turns the watchdog off
+	int maxOverruns; //<! strikes before a fire-and-forget hook is demoted
+	int demotedPeriod; //<! frames between calls of a demoted hook
+
+	void LogHookStats();
+
 	PythonScripting(int teamId, std::string datadir);
 	~PythonScripting();
 
+	/// bumped by python whenever the config changes
+	static int configVersion;
+	static int GetConfigVersion() { return configVersion; }
+
 	static void RegisterAI(int teamId, BaczekKPAI *);
 	static void UnregisterAI(int teamId);
 	static BaczekKPAI* GetAIForTeam(int teamId);
@@ -40,12 +83,26 @@ public:
 					const std::vector<float3>& friendlies,
 					const std::vector<float3>& enemies);
 
+	/// make the buffers readable from python without copying
+	///
+	/// Both objects must outlive this one and must not reallocate their
+	/// storage afterwards.
+	void ExposeWorld(WorldSnapshot& snapshot, InfluenceMap& influence);
+	bool HasWorldFrame() const { return hasWorldFrame; }
+	void WorldFrame(const WorldSnapshot& snapshot);
+
 	int GetBuilderRetreatTimeout(int frameNum);
 	int GetWantedConstructors(int geospots, int mapwidth, int mapheight);
-	int GetBuildSpotPriority(float distance, int influence, int mapwidth, int mapheight, int def);
+	/// scores all spots in one call, returns false if there's no usable hook
+	bool GetBuildSpotPriorities(const std::vector<float>& distances,
+			const std::vector<int>& influences, int mapwidth, int mapheight,
+			std::vector<int>& priorities);
 
 	template<typename T> T extract_default(bp::object obj, T def)
 	{
+		// not defined, failed or skipped
+		if (obj.ptr() == Py_None)
+			return def;
 		try {
 			return bp::extract<T>(obj);
 		} catch (bp::error_already_set&) {
@@ -56,6 +113,8 @@ public:
 
 	template<typename T1, typename T2, typename Ret> Ret extract_default(bp::object obj, Ret def)
 	{
+		if (obj.ptr() == Py_None)
+			return def;
 		try {
 			return Ret(bp::extract<T1>(obj));
 		} catch (bp::error_already_set&) {
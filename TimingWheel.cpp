@@ -0,0 +1,79 @@
+#include <cassert>
+#include <algorithm>
+
+#include "TimingWheel.h"
+
+
+TimingWheel::TimingWheel()
+{
+	currentFrame = 0;
+	count = 0;
+}
+
+
+void TimingWheel::Schedule(int id, int frame)
+{
+	Insert(Entry(id, frame));
+	++count;
+}
+
+
+void TimingWheel::Insert(const Entry& e)
+{
+	int frame = std::max(e.frame, currentFrame);
+	int delta = frame - currentFrame;
+
+	for (int level = 0; level < LEVELS; ++level) {
+		int shift = SLOT_BITS*level;
+		if (delta < (SLOTS << shift) || level == LEVELS-1) {
+			// too far into the future - park it in the last slot reachable
+			// from the top level, it'll be reinserted when cascaded
+			if (level == LEVELS-1 && delta >= (SLOTS << shift))
+				frame = currentFrame + (SLOTS << shift) - 1;
+			wheel[level][(frame >> shift) & (SLOTS-1)].push_back(e);
+			return;
+		}
+	}
+}
+
+
+void TimingWheel::Cascade(int level)
+{
+	Slot tmp;
+	tmp.swap(wheel[level][(currentFrame >> (SLOT_BITS*level)) & (SLOTS-1)]);
+	for (Slot::iterator it = tmp.begin(); it != tmp.end(); ++it) {
+		Insert(*it);
+	}
+}
+
+
+void TimingWheel::Advance(int frame, std::vector<int>& expired)
+{
+	if (count == 0) {
+		// nothing to do, skip ahead
+		currentFrame = std::max(currentFrame, frame+1);
+		return;
+	}
+
+	for (; currentFrame <= frame; ++currentFrame) {
+		// move entries down when lower levels wrap around
+		for (int level = 1; level < LEVELS; ++level) {
+			if ((currentFrame & ((1 << (SLOT_BITS*level)) - 1)) != 0)
+				break;
+			Cascade(level);
+		}
+
+		Slot tmp;
+		tmp.swap(wheel[0][currentFrame & (SLOTS-1)]);
+		for (Slot::iterator it = tmp.begin(); it != tmp.end(); ++it) {
+			assert(it->frame <= currentFrame);
+			expired.push_back(it->id);
+			--count;
+		}
+
+		if (count == 0) {
+			currentFrame = std::max(currentFrame+1, frame+1);
+			break;
+		}
+	}
+}
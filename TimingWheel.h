@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+/// hierarchical timing wheel keyed by frame number
+///
+/// Level 0 has one slot per frame, every next level covers SLOTS times more
+/// frames per slot. Entries are moved down a level when the lower level
+/// wraps around, so each entry is touched at most LEVELS times and Advance
+/// costs O(expired) plus a constant per frame.
+/// Cancellation is lazy: the owner checks expired ids against its own state.
+class TimingWheel
+{
+public:
+	TimingWheel();
+
+	static const int SLOT_BITS = 6;
+	static const int SLOTS = 1 << SLOT_BITS;
+	static const int LEVELS = 4;
+
+	/// fire id at frame; frames in the past fire on the next Advance
+	void Schedule(int id, int frame);
+	/// fire everything due up to and including frame, ids are appended to expired
+	void Advance(int frame, std::vector<int>& expired);
+
+	size_t size() const { return count; }
+	bool empty() const { return count == 0; }
+
+protected:
+	struct Entry {
+		int id;
+		int frame;
+		Entry(int i, int f):id(i), frame(f) {}
+	};
+	typedef std::vector<Entry> Slot;
+
+	Slot wheel[LEVELS][SLOTS];
+	int currentFrame; //<! next frame to be processed
+	size_t count;
+
+	void Insert(const Entry& e);
+	void Cascade(int level);
+};
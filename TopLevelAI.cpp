@@ -1,8 +1,8 @@
 #include <algorithm>
 #include <strstream>
 #include <cmath>
+#include <boost/bind.hpp>
 #include <boost/foreach.hpp>
-#include <boost/timer.hpp>
 #include <cfloat>
 
 #include "ExternalAI/IGlobalAICallback.h"
@@ -11,6 +11,7 @@
 
 #include "KPCommands.h"
 #include "Log.h"
+#include "Profiler.h"
 #include "Goal.h"
 #include "TopLevelAI.h"
 #include "BaczekKPAI.h"
@@ -18,7 +19,9 @@
 #include "RNG.h"
 
 
-TopLevelAI::TopLevelAI(BaczekKPAI* theai)
+TopLevelAI::TopLevelAI(BaczekKPAI* theai):
+		GoalProcessor(&theai->goalRegistry),
+		planner(this)
 {
 	builderRetreatGoalId = -1;
 	ai = theai;
@@ -32,10 +35,27 @@ TopLevelAI::TopLevelAI(BaczekKPAI* theai)
 	lastRetreatTime = lastBattleRetreatTime = -10000;
 
 	queuedConstructors = 0;
+
+	// one task, so deferring it can't split dispatching from goal finding
+	FrameScheduler& sched = ai->scheduler;
+	scheduledTasks.push_back(sched.AddTask("FindGoals", GAME_SPEED*10, 1, 5, 1500,
+			boost::bind(&TopLevelAI::DispatchAndFindGoals, this)));
+	scheduledTasks.push_back(sched.AddTask("StepPlanner", 1, 0, 2, 200,
+			boost::bind(&TopLevelAI::StepPlanner, this, _1)));
+	scheduledTasks.push_back(sched.AddTask("TopLevelAI::ProcessGoalStack", GAME_SPEED, 0,
+			sched.criticalPriority, 500,
+			boost::bind(&TopLevelAI::ProcessGoalStack, this, _1)));
+	scheduledTasks.push_back(sched.AddTask("RetreatUnusedUnits", GAME_SPEED, 1, 3, 200,
+			boost::bind(&UnitGroupAI::RetreatUnusedUnits, builders)));
+	scheduledTasks.push_back(sched.AddTask("FindPointerTargets", GAME_SPEED, 2, 3, 500,
+			boost::bind(&TopLevelAI::FindPointerTargets, this)));
 }
 
 TopLevelAI::~TopLevelAI(void)
 {
+	BOOST_FOREACH(int taskId, scheduledTasks) {
+		ai->scheduler.RemoveTask(taskId);
+	}
 	delete builders; builders = 0;
 	delete bases; bases = 0;
 	delete expansions; expansions = 0;
@@ -43,43 +63,22 @@ TopLevelAI::~TopLevelAI(void)
 
 void TopLevelAI::Update()
 {
-	boost::timer total;
-
-	int frameNum = ai->cb->GetCurrentFrame();
+	PROFILE_ZONE("TopLevelAI::Update");
 
 	// check if builder's rally point is ok
 	if (builders->rallyPoint.x < 0 && !bases->units.empty()) {
 		builders->rallyPoint = random_offset_pos(ai->cb->GetUnitPos(bases->units.begin()->first), SQUARE_SIZE*10, SQUARE_SIZE*40);
 	}
 
-	if (frameNum % (GAME_SPEED * 10) == 1) {
-		// dispatch before looking for goals
-		DispatchPackets();
-	}
-
-	if (frameNum % (GAME_SPEED * 10) == 3) {
-		FindGoals();
-	}
-
-	if (frameNum % GAME_SPEED == 0) {
-		ProcessGoalStack(frameNum);
-	}
+	// goal finding and processing runs from ai->scheduler
 
 	// update unit groups
 	builders->Update();
-	if (frameNum % GAME_SPEED == 1) {
-		builders->RetreatUnusedUnits();
-	} else if (frameNum % GAME_SPEED == 2) {
-		FindPointerTargets();
-	} 
-
 	bases->Update();
 	expansions->Update();
 	BOOST_FOREACH(UnitGroupAI& it, groups) {
 		it.Update();
 	}
-
-	ailog->info() << __FUNCTION__ << " " << total.elapsed() << std::endl;
 }
 
 
@@ -107,13 +106,13 @@ GoalProcessor::goal_process_t TopLevelAI::ProcessGoal(Goal* g)
 			ProcessDefend(g);
 			break;
 		default:
-			ailog->info() << "unknown goal type: " << g->type << " params "
+			LOG_INFO << "unknown goal type: " << g->type << " params "
 				<< g->params.size() << std::endl;
 			std::stringstream ss;
-			BOOST_FOREACH(Goal::param_variant p, g->params) {
+			BOOST_FOREACH(const Goal::param_type& p, g->params) {
 				ss << p << ", ";
 			}
-			ailog->info() << "params: " << ss.str() << endl;
+			LOG_INFO << "params: " << ss.str() << endl;
 	}
 	return PROCESS_CONTINUE;
 }
@@ -121,10 +120,10 @@ GoalProcessor::goal_process_t TopLevelAI::ProcessGoal(Goal* g)
 
 void TopLevelAI::ProcessBuildExpansion(Goal* g)
 {
-	ailog->info() << "goal " << g->id << ": BUILD_EXPANSION (" << g->params[0] << ")" << std::endl;
+	LOG_INFO << "goal " << g->id << ": BUILD_EXPANSION (" << g->params[0] << ")" << std::endl;
 	if (!g->is_executing() && skippedGoals.find(g->id) == skippedGoals.end()) {
 		// add goal for builder group
-		Goal *newgoal = Goal::GetGoal(Goal::CreateGoal(g->priority, BUILD_EXPANSION));
+		Goal *newgoal = goalRegistry->GetGoal(goalRegistry->CreateGoal(g->priority, BUILD_EXPANSION));
 		newgoal->params.push_back(g->params[0]);
 		newgoal->parent = g->id;
 
@@ -146,16 +145,16 @@ void TopLevelAI::ProcessBuildExpansion(Goal* g)
 
 void TopLevelAI::ProcessDefend(Goal* g)
 {
-	ailog->info() << "goal " << g->id << ": DEFEND_AREA (" << g->params[0] << ")" << std::endl;
+	LOG_INFO << "goal " << g->id << ": DEFEND_AREA (" << g->params[0] << ")" << std::endl;
 	if (g->is_executing() || skippedGoals.find(g->id) == skippedGoals.end())
 		return;
-	const float3& pos = boost::get<float3>(g->params[0]);
+	const float3 pos = g->params[0].as_float3();
 	float3 realpos;
 	int inf = 0;
 	ai->influence->FindLocalMinNear(pos, realpos, inf);
-	ailog->info() << "defense: sent to (" << realpos << ") - influence " << inf << std::endl;
+	LOG_INFO << "defense: sent to (" << realpos << ") - influence " << inf << std::endl;
 
-	Goal* newgoal = Goal::GetGoal(Goal::CreateGoal(g->priority*10, MOVE));
+	Goal* newgoal = goalRegistry->GetGoal(goalRegistry->CreateGoal(g->priority*10, MOVE));
 
 	g->OnAbort(AbortGoal(*newgoal));
 	g->OnAbort(RemoveGoalFromSkipped(*this));
@@ -175,9 +174,9 @@ void TopLevelAI::ProcessDefend(Goal* g)
 
 void TopLevelAI::ProcessBuildConstructor(Goal* g)
 {
-	ailog->info() << "goal " << g->id << ": BUILD_CONSTRUCTOR" << std::endl;
+	LOG_INFO << "goal " << g->id << ": BUILD_CONSTRUCTOR" << std::endl;
 	if (!g->is_executing()) {
-		Goal *newgoal = Goal::GetGoal(Goal::CreateGoal(g->priority, BUILD_CONSTRUCTOR));
+		Goal *newgoal = goalRegistry->GetGoal(goalRegistry->CreateGoal(g->priority, BUILD_CONSTRUCTOR));
 		newgoal->parent = g->id;
 		
 		g->OnAbort(AbortGoal(*newgoal));
@@ -197,194 +196,156 @@ void TopLevelAI::ProcessBuildConstructor(Goal* g)
 //////////////////////////////////////////////////////////////////////////////////////
 
 
+/// dispatch before looking for goals
+void TopLevelAI::DispatchAndFindGoals()
+{
+	DispatchPackets();
+	FindGoals();
+}
+
 /// high-level routine
 void TopLevelAI::FindGoals()
 {
-	boost::timer t;
-
-	std::vector<float3> badSpots;
-	FindGoalsExpansion(badSpots); // badSpots gets modified here
-	FindGoalsRetreatBuilders(badSpots); // and used here
+	PROFILE_ZONE("TopLevelAI::FindGoals");
+
+	// expansion spots need path lengths, they're scored over the next
+	// frames by StepPlanner
+	if (planner.IsRunning()) {
+		LOG_INFO << "expansion plan still running, not restarting it" << std::endl;
+	} else {
+		planner.Start(ai->cb->GetCurrentFrame());
+	}
 
+	// doesn't wait for the plan, so builders retreat even if it's slow
+	FindGoalsRetreatBuilders();
 	FindGoalsBuildConstructors();
 	FindBaseBuildGoals();
 
 	FindBattleGroupGoals();
-
-	ailog->info() << __FUNCTION__ << " took " << t.elapsed() << std::endl;
 }
 
-/// find suitable expansion spots
-/// also find spots that can't be expanded on, return them in badSpots
-void TopLevelAI::FindGoalsExpansion(std::vector<float3>& badSpots)
+void TopLevelAI::StepPlanner(int frameNum)
 {
-	boost::timer t;
-
-	// find free geo spots to build expansions on
-	ailog->info() << "FindGoal() expansions" << std::endl;
-	BOOST_FOREACH(float3 geo, ai->geovents) {
-		// check if the expansion spot is taken
-		std::vector<int> stuff;
-		ai->GetAllUnitsInRadius(stuff, geo, 8);
-		bool badspot = false;
-		BOOST_FOREACH(int id, stuff) {
-			// TODO switch to CanBuildAt?
-			const UnitDef* ud = ai->cheatcb->GetUnitDef(id);
-			bool alive = ai->cheatcb->GetUnitHealth(id) > 0;
-			assert(ud);
-			// TODO make configurable
-			if (alive && (Unit::IsBase(ud) || Unit::IsExpansion(ud) || Unit::IsSuperWeapon(ud))) {
-				badspot = true;
-				ailog->info() << "found blocking " << ud->name << " at  " << ai->cheatcb->GetUnitPos(id) << std::endl;
-				break;
-			}
-		}
-		if (badspot) {
-			badSpots.push_back(geo);
-			ailog->info() << geo << " is a bad spot" << std::endl;
-			continue;
-		}
+	if (!planner.Step(frameNum))
+		return;
 
-		// calculate priority
-		float minDistance = bases->DistanceClosestUnit(geo, 0, 0);
+	PROFILE_ZONE("TopLevelAI::StepPlanner");
+	ApplyExpansionPlan(planner.GetPlan());
+	RemoveGoalsOnBadSpots(planner.GetPlan().badSpots);
+	FindGoalsRetreatBuilders();
+}
 
-		// can't reach
-		if (minDistance < 0) {
-			ailog->info() << "can't reach geo at " << geo << std::endl;
+/// apply what the planner found, it may be a few frames old so check
+/// every change against current goals
+void TopLevelAI::ApplyExpansionPlan(const ExpansionPlanner::Plan& plan)
+{
+	// goals without a position aren't in the spatial index, drop them
+	std::vector<int> expansionGoals;
+	index.GetGoalsOfType(BUILD_EXPANSION, expansionGoals);
+	BOOST_FOREACH(int gid, expansionGoals) {
+		Goal* goal = goalRegistry->GetGoal(gid);
+		if (!goal)
 			continue;
+		if (goal->params.empty()) {
+			LOG_ERROR << "TopLevel BUILD_EXPANSION without param, removing" << endl;
+			goalRegistry->RemoveGoal(goal);
+		} else if (!goal->params[0].is_float3()) {
+			LOG_ERROR << "TopLevel BUILD_EXPANSION with param 0 not float3 ("
+				<< goal->params[0] << "), removing" << endl;
+			goalRegistry->RemoveGoal(goal);
 		}
+	}
 
-		int influence = ai->influence->GetAtXY(geo.x, geo.z);
-		if (influence < ai->python->GetIntValue("expansionInfluenceLimit", 0)) {
-			ailog->info() << "too risky to build an expansion at " << geo << std::endl;
+	BOOST_FOREACH(int gid, plan.abort) {
+		Goal* goal = goalRegistry->GetGoal(gid);
+		if (!goal || goal->is_executing())
 			continue;
-		}
+		LOG_INFO << "aborting old BUILD_EXPANSION goal " << goal->id << " at "
+			<< goal->params[0] << endl;
+		goalRegistry->RemoveGoal(goal);
+	}
 
-		float k = 15;
-		float divider = (float)(ai->map.w + ai->map.h);
-		int priority = ai->python->GetBuildSpotPriority(minDistance, influence, ai->map.w, ai->map.h, INT_MAX);
-		if (priority == INT_MAX)
-			priority = influence - (int)((minDistance/divider)*k);
-		ailog->info() << "geo at " << geo << " distance to nearest base squared " << minDistance
-			<< " influence " << influence << " priority " << priority << std::endl;
-		// check if there already is a goal with this position
+	BOOST_FOREACH(const ExpansionPlanner::NewGoal& ng, plan.add) {
+		// goals may have been added since the spot was scored
 		bool dontadd = false;
-		BOOST_FOREACH(int gid, goals) {
-			Goal* goal = Goal::GetGoal(gid);
-			if (!goal) {
-				ailog->info() << "Goal " << gid << " doesn't exist" << endl;
-				continue;
+		std::vector<int> sameSpot;
+		index.FindGoalsNear(BUILD_EXPANSION, ng.pos, 1, sameSpot);
+		BOOST_FOREACH(int gid, sameSpot) {
+			Goal* goal = goalRegistry->GetGoal(gid);
+			if (goal && (goal->priority == ng.priority || goal->is_executing())) {
+				dontadd = true;
+				break;
 			}
-			if (goal->type != BUILD_EXPANSION)
-				continue;
+		}
+		if (dontadd)
+			continue;
+
+		Goal *g = goalRegistry->GetGoal(goalRegistry->CreateGoal(ng.priority, BUILD_EXPANSION));
+		g->params.push_back(ng.pos);
+		g->timeoutFrame = ai->cb->GetCurrentFrame() + 5*60*GAME_SPEED;
+		AddGoal(g);
+	}
+}
 
-			if (goal->params.empty()) {
-				ailog->error() << "TopLevel BUILD_EXPANSION without param, removing" << endl;
-				Goal::RemoveGoal(goal);
+/// remove BUILD_EXPANSION goals that are placed on spots which are now bad
+void TopLevelAI::RemoveGoalsOnBadSpots(const std::vector<float3>& badSpots)
+{
+	BOOST_FOREACH(float3 geo, badSpots) {
+		std::vector<int> onSpot;
+		index.FindGoalsNear(BUILD_EXPANSION, geo, 1, onSpot);
+		BOOST_FOREACH(int gid, onSpot) {
+			if (skippedGoals.find(gid) != skippedGoals.end())
 				continue;
-			}
-			float3 *param = boost::get<float3>(&goal->params[0]);
-			if (!param) {
-				ailog->error() << "TopLevel BUILD_EXPANSION with param 0 not float3 (" << goal->params[0] << "), removing" << endl;
-				Goal::RemoveGoal(goal);
+			Goal* goal = goalRegistry->GetGoal(gid);
+			if (!goal || goal->is_executing())
 				continue;
-			}
-
-			// try to avoid duplicate goals, don't abort goals which are being executed
-			if (param->SqDistance2D(geo) < 1) {
-				if (goal->priority == priority || goal->is_executing()) {
-					dontadd = true;
-					break;
-				} else {
-					ailog->info() << "aborting old BUILD_EXPANSION goal " << goal->id << " at " << *param << endl;
-					Goal::RemoveGoal(goal);
-				}
-			}
-		}
-		// add the goal
-		if (!dontadd) {
-			Goal *g = Goal::GetGoal(Goal::CreateGoal(priority, BUILD_EXPANSION));
-			g->params.push_back(geo);
-			g->timeoutFrame = ai->cb->GetCurrentFrame() + 5*60*GAME_SPEED;
-			AddGoal(g);
+			goalRegistry->RemoveGoal(goal);
 		}
 	}
-
-	ailog->info() << __FUNCTION__ << " took " << t.elapsed() << std::endl;
 }
 
-/// remove BUILD_EXPANSION goals that are placed on spots which are now bad
-/// also, when there are no spots left to build on, retreat whole builder group
-void TopLevelAI::FindGoalsRetreatBuilders(std::vector<float3>& badSpots)
+/// when there are no spots left to build on, retreat whole builder group
+void TopLevelAI::FindGoalsRetreatBuilders()
 {
-	boost::timer t;
-	// filter out goals on bad spots
-	// also check if there are BUILD_EXPANSION goals at all
+	PROFILE_ZONE("TopLevelAI::FindGoalsRetreatBuilders");
+	// check if there are BUILD_EXPANSION goals at all
 	// if there are none, issue a RETREAT goal
-	int expansionGoals = 0;
-	bool hasRetreat = false;
-	BOOST_FOREACH(int gid, goals) {
-		Goal* goal = Goal::GetGoal(gid);
-		if (!goal)
-			continue;
-		if (goal->type != BUILD_EXPANSION) {
-			if (goal->type == RETREAT)
-				hasRetreat = true;
-			continue;
-		}
-		++expansionGoals;
-		if (skippedGoals.find(gid) != skippedGoals.end())
-			continue;
-		if (goal->is_executing())
-			continue;
-		float3 *param = boost::get<float3>(&goal->params[0]);
-		assert(param);
+	int expansionGoals = index.CountType(BUILD_EXPANSION);
+	// the retreat goal lives in the builder group
+	Goal* retreat = goalRegistry->GetGoal(builderRetreatGoalId);
+	bool hasRetreat = retreat && !retreat->is_finished();
 
-		BOOST_FOREACH(float3 geo, badSpots) {
-			if (geo == *param) {
-				Goal::RemoveGoal(goal);
-				--expansionGoals;
-				break;
-			}
-		}
-	}
-	
-	assert(expansionGoals >= 0);
 	if (expansionGoals == 0) {
-		ailog->info() << "no expansion goals found" << std::endl;
+		LOG_INFO << "no expansion goals found" << std::endl;
 	}
 	// retreat if needed
 	if (expansionGoals == 0 && !hasRetreat) {
 		// there are no expansions left to take, retreat builders
 		// retreat to one of the bases
 		// unless there are no bases or the group is reasonably close to the base
-		if (!bases->units.empty()) {
-			const int maxDist = ai->python->GetIntValue("builderRetreatMaxDist", 40*SQUARE_SIZE);
-			const int minDist = ai->python->GetIntValue("builderRetreatMinDist", 10*SQUARE_SIZE);
-			const int checkOffset = ai->python->GetIntValue("builderRetreatCheckOffset", 10*SQUARE_SIZE);
+		if (!bases->units.empty() && !builders->units.empty()) {
+			const int maxDist = ai->config.builderRetreatMaxDist;
+			const int minDist = ai->config.builderRetreatMinDist;
+			const int checkOffset = ai->config.builderRetreatCheckOffset;
 			const int checkDist = maxDist+checkOffset;
 			float3 basePos = ai->cb->GetUnitPos(bases->units.begin()->second->owner->id);
 			float3 midPos = builders->GetGroupMidPos();
 			if (midPos.SqDistance2D(basePos) > checkDist*checkDist) {
 				// not close enough
 				float3 dest = random_offset_pos(basePos, minDist, maxDist);
-				Goal* goal = Goal::GetGoal(Goal::CreateGoal(1, RETREAT));
+				Goal* goal = goalRegistry->GetGoal(goalRegistry->CreateGoal(1, RETREAT));
 				goal->params.push_back(dest);
-				goal->timeoutFrame = ai->python->GetBuilderRetreatTimeout(ai->cb->GetCurrentFrame());
+				goal->timeoutFrame = ai->formulas.GetBuilderRetreatTimeout(ai->cb->GetCurrentFrame());
 				builders->AddGoal(goal);
 				builderRetreatGoalId = goal->id;
 			}
 		}
 	} else if (expansionGoals > 0 && hasRetreat) {
 		// retreat should be aborted due to new construction goal
-		ailog->info() << "aborting builder RETREAT goal" << std::endl;
-		Goal* retreat = Goal::GetGoal(builderRetreatGoalId);
-		if (retreat) {
-			Goal::RemoveGoal(retreat);
-			builderRetreatGoalId = -1;
-		}
+		LOG_INFO << "aborting builder RETREAT goal" << std::endl;
+		goalRegistry->RemoveGoal(retreat);
+		builderRetreatGoalId = -1;
 	}
-	ailog->info() << __FUNCTION__ << " took " << t.elapsed() << std::endl;
 }
 
 
@@ -402,37 +363,29 @@ public:
 /// decides whether to build constructors
 void TopLevelAI::FindGoalsBuildConstructors()
 {
-	boost::timer t;
+	PROFILE_ZONE("TopLevelAI::FindGoalsBuildConstructors");
 	/////////////////////////////////////////////////////
 	// count own constructors and BUILD_CONSTRUCTOR goals
-	ailog->info() << "FindGoal() constructors" << std::endl;
+	LOG_INFO << "FindGoal() constructors" << std::endl;
 
 	int bldcnt = std::count_if(ai->myUnits.begin(), ai->myUnits.end(), IsConstructor(ai));
-	ailog->info() << "FindGoal() found " << bldcnt  << " constructors" << std::endl;
+	LOG_INFO << "FindGoal() found " << bldcnt  << " constructors" << std::endl;
 	
-	int goalcnt = 0;
-	BOOST_FOREACH(int gid, goals) {
-		Goal* g = Goal::GetGoal(gid);
-		if (!g)
-			continue;
-		if (g->type == BUILD_CONSTRUCTOR)
-			++goalcnt;
-	}
-	ailog->info() << "FindGoal() found " << goalcnt  << " BUILD_CONSTRUCTOR goals" << std::endl;
+	int goalcnt = index.CountType(BUILD_CONSTRUCTOR);
+	LOG_INFO << "FindGoal() found " << goalcnt  << " BUILD_CONSTRUCTOR goals" << std::endl;
 
 	// determine the amount of needed constructors
-	int wantedCtors = ai->python->GetWantedConstructors(ai->geovents.size(), ai->map.w, ai->map.h);
+	int wantedCtors = ai->formulas.GetWantedConstructors(ai->geovents.size(), ai->map.w, ai->map.h);
 	if (builders->units.empty()
 				|| goalcnt + bldcnt + queuedConstructors < wantedCtors - expansions->units.empty() - groups[currentBattleGroup].units.empty()) {
-		ailog->info() << "adding BUILD_CONSTRUCTOR goal" << std::endl;
-		Goal* g = Goal::GetGoal(Goal::CreateGoal(1, BUILD_CONSTRUCTOR));
+		LOG_INFO << "adding BUILD_CONSTRUCTOR goal" << std::endl;
+		Goal* g = goalRegistry->GetGoal(goalRegistry->CreateGoal(1, BUILD_CONSTRUCTOR));
 		assert(g);
 		AddGoal(g);
 		++queuedConstructors;
 	}
 
-	std::sort(goals.begin(), goals.end(), goal_priority_less());
-	ailog->info() << __FUNCTION__ << " took " << t.elapsed() << std::endl;
+	goalRegistry->SortByPriority(goals);
 }
 
 //////////////////////////////////////////////////////////////////////////////////////
@@ -442,9 +395,9 @@ void TopLevelAI::FindGoalsBuildConstructors()
 
 void TopLevelAI::FindBattleGroupGoals()
 {
-	boost::timer t;
+	PROFILE_ZONE("TopLevelAI::FindBattleGroupGoals");
 
-	ailog->info() << "assign group size: " << groups[currentAssignGroup].units.size()
+	LOG_INFO << "assign group size: " << groups[currentAssignGroup].units.size()
 		<< " battle group size: " << groups[currentBattleGroup].units.size() << std::endl;
 
 	int frameNum = ai->cb->GetCurrentFrame();
@@ -468,11 +421,11 @@ void TopLevelAI::FindBattleGroupGoals()
 	// change state with some probability
 	// TODO be smarter about this
 	// TODO move constants to config file
-	float healthRetreatLimit = ai->python->GetFloatValue("battleGroupHealthRetreatLimit", 0.2);
+	float healthRetreatLimit = ai->config.battleGroupHealthRetreatLimit;
 	bool healthDepleted = (float)groups[currentBattleGroup].GetGroupHealth()/(float)attackStartHealth < healthRetreatLimit;
 	if (!groups[currentBattleGroup].units.empty()) {
 		if (!healthDepleted && attackState == AST_GATHER
-				&& ai->python->GetIntValue("attackStateChangeTimeout", lastStateChangeTime + 90*GAME_SPEED) < frameNum
+				&& ai->config.attackStateChangeTimeout < frameNum
 				&& randfloat() < 0.25) {
 			// try to be smart: if health isn't depleted, attack
 			ai->SendTextMsg("set mode to attack (!hd)", 0);
@@ -482,7 +435,7 @@ void TopLevelAI::FindBattleGroupGoals()
 			SetAttackState(AST_GATHER);
 			ai->SendTextMsg("set mode to gather (hd)", 0);
 		}
-		else if (!ImportantTargetInRadius(midpos, ai->python->GetFloatValue("importantRadius", 1000)) && randfloat() < 0.1) {
+		else if (!ImportantTargetInRadius(midpos, ai->config.importantRadius) && randfloat() < 0.1) {
 			if (attackState == AST_ATTACK) {
 				
 				// not so smart, toggle state
@@ -501,18 +454,15 @@ void TopLevelAI::FindBattleGroupGoals()
 
 	FindGoalsGather();
 	FindGoalsAttack();
-	ailog->info() << __FUNCTION__ << " took " << t.elapsed() << std::endl;
 }
 
 
 void TopLevelAI::FindGoalsGather()
 {
-	boost::timer t;
+	PROFILE_ZONE("TopLevelAI::FindGoalsGather");
 
 	FindGoalsAssignGroupGather();
 	FindGoalsBattleGroupGather();
-
-	ailog->info() << __FUNCTION__ << " took " << t.elapsed() << std::endl;
 }
 
 void TopLevelAI::FindGoalsAssignGroupGather()
@@ -521,8 +471,8 @@ void TopLevelAI::FindGoalsAssignGroupGather()
 	if (groups[currentAssignGroup].units.empty())
 		return;
 
-	const float gatherMinOffset = ai->python->GetFloatValue("gatherMinOffset", 256);
-	const float gatherMaxOffset = ai->python->GetFloatValue("gatherMaxOffset", 768);
+	const float gatherMinOffset = ai->config.gatherMinOffset;
+	const float gatherMaxOffset = ai->config.gatherMaxOffset;
 	float3 gatherSpot = random_offset_pos(groups[currentAssignGroup].GetGroupMidPos(), gatherMinOffset, gatherMaxOffset);
 	float3 rootSpot = gatherSpot + float3(0, 100, 0); // only for debugging
 
@@ -537,7 +487,7 @@ void TopLevelAI::FindGoalsAssignGroupGather()
 	float3 foundSpot;
 	int found = -1;
 
-	int rushBaseUnitCount = ai->python->GetIntValue("rushBaseUnitCount", 250);
+	int rushBaseUnitCount = ai->config.rushBaseUnitCount;
 	if (rushBaseUnitCount <= 0)
 		rushBaseUnitCount = 250;
 	if (groups[currentAssignGroup].units.size() >= (size_t)rushBaseUnitCount
@@ -574,7 +524,7 @@ void TopLevelAI::FindGoalsAssignGroupGather()
 	// not enough units to rush hq, try to move to some enemies nearby
 	// fix "goto crosses initialization" error - add scope
 	{
-		const float baseDefenseRadius = ai->python->GetFloatValue("baseDefenseRadius", 1536);
+		const float baseDefenseRadius = ai->config.baseDefenseRadius;
 		numenemies = ai->cheatcb->GetEnemyUnits(enemies, gatherSpot, baseDefenseRadius);
 		// find the closest enemy and sent group there
 		float sqdist = FLT_MAX;
@@ -671,7 +621,7 @@ void TopLevelAI::SetAttackState(TopLevelAI::AttackState state)
 
 void TopLevelAI::FindGoalsAttack()
 {
-	boost::timer t;
+	PROFILE_ZONE("TopLevelAI::FindGoalsAttack");
 
 	if (attackState != AST_ATTACK)
 		return;
@@ -681,7 +631,7 @@ void TopLevelAI::FindGoalsAttack()
 	ai->influence->FindLocalMinima(256, values, positions);
 
 	if (values.empty()) {
-		ailog->info() << "FindLocalMinima didn't return any interesting points" << std::endl;
+		LOG_INFO << "FindLocalMinima didn't return any interesting points" << std::endl;
 		return;
 	}
 
@@ -707,7 +657,7 @@ void TopLevelAI::FindGoalsAttack()
 				const UnitDef* unitdef = ai->cheatcb->GetUnitDef(*it);
 				if (unitdef && (Unit::IsBase(unitdef) || Unit::IsExpansion(unitdef) || Unit::IsSuperWeapon(unitdef))) {
 					groups[currentBattleGroup].AttackMoveToSpot(ai->cheatcb->GetUnitPos(*it));
-					ailog->info() << "overwhelming attack " << unitdef->name << " at " << ai->cheatcb->GetUnitPos(*it) << std::endl;
+					LOG_INFO << "overwhelming attack " << unitdef->name << " at " << ai->cheatcb->GetUnitPos(*it) << std::endl;
 					break;
 				}
 			}
@@ -722,13 +672,13 @@ void TopLevelAI::FindGoalsAttack()
 					const UnitDef* unitdef = ai->cheatcb->GetUnitDef(*it);
 					if (unitdef && (Unit::IsBase(unitdef) || Unit::IsExpansion(unitdef) || Unit::IsSuperWeapon(unitdef))) {
 						// found a suitable target
-						Goal* g = Goal::GetGoal(Goal::CreateGoal(11, ATTACK));
+						Goal* g = goalRegistry->GetGoal(goalRegistry->CreateGoal(11, ATTACK));
 						g->timeoutFrame = 120*GAME_SPEED;
 						g->params.push_back(*it);
 						groups[currentBattleGroup].AddGoal(g);
 						ai->CreateLineFigure(ai->cheatcb->GetUnitPos(*it)+float3(0, 100, 0),
 							positions[minminidx]+float3(0, 100, 0), 5, 5, 600, 0);
-						ailog->info() << "proceeding to attack " << unitdef->name << " at " << ai->cheatcb->GetUnitPos(*it) << std::endl;
+						LOG_INFO << "proceeding to attack " << unitdef->name << " at " << ai->cheatcb->GetUnitPos(*it) << std::endl;
 						break;
 					}
 				}
@@ -747,7 +697,6 @@ void TopLevelAI::FindGoalsAttack()
 			ai->CreateLineFigure(ai->cb->GetUnitPos(bases->units.begin()->first)+float3(0, 100, 0), float3(ai->map.w*0.5f, 0, ai->map.h*0.5f), 5, 5, 600, 0);
 		}
 	}
-	ailog->info() << __FUNCTION__ << " took " << t.elapsed() << std::endl;
 }
 
 //////////////////////////////////////////////////////////////////////////////////////
@@ -777,7 +726,7 @@ void TopLevelAI::FindBaseBuildGoals()
 				const UnitDef* unitdef = ai->cb->GetUnitDef(unit.c_str());
 				if (unitdef) {
 					build.id = -unitdef->id;
-					ai->cb->GiveOrder(baseid, &build);
+					ai->orders.GiveOrder(baseid, build);
 				}
 			}
 			break;
@@ -788,7 +737,7 @@ void TopLevelAI::FindBaseBuildGoals()
 			const UnitDef* unitdef = ai->cb->GetUnitDef(unit.c_str());
 			if (unitdef) {
 				build.id = -unitdef->id;
-				ai->cb->GiveOrder(baseid, &build);
+				ai->orders.GiveOrder(baseid, build);
 			}
 		}
 		case 2: { // pointer
@@ -797,7 +746,7 @@ void TopLevelAI::FindBaseBuildGoals()
 			const UnitDef* unitdef = ai->cb->GetUnitDef(unit.c_str());
 			if (unitdef) {
 				build.id = -unitdef->id;
-				ai->cb->GiveOrder(baseid, &build);
+				ai->orders.GiveOrder(baseid, build);
 			}
 		}
 		default:
@@ -815,7 +764,7 @@ struct RemoveSuspendedPointerGoal : std::unary_function<Goal&, void>
 
 void TopLevelAI::FindPointerTargets()
 {
-	boost::timer t;
+	PROFILE_ZONE("TopLevelAI::FindPointerTargets");
 
 	int enemies[MAX_UNITS];
 	int numenemies;
@@ -836,7 +785,7 @@ void TopLevelAI::FindPointerTargets()
 			if (ai->influence->GetAtXY(pos.x, pos.z) < 0)
 				continue;
 
-			float radius = ai->python->GetFloatValue((myud->name + "_radius").c_str(), 1000);
+			float radius = ai->config.GetFloat(myud->name + "_radius", 1000);
 			numenemies = ai->cb->GetEnemyUnits(enemies, pos, radius);
 			int smallTargets = 0;
 			bool stopMoving = false;
@@ -866,12 +815,12 @@ void TopLevelAI::FindPointerTargets()
 			}
 
 			assert(ai->GetUnit(myid)->ai);
-			Goal* goal = Goal::GetGoal(ai->GetUnit(myid)->ai->currentGoalId);
+			Goal* goal = goalRegistry->GetGoal(ai->GetUnit(myid)->ai->currentGoalId);
 			UnitAI* unitai = ai->GetUnit(myid)->ai.get();
 
 			if (foundid != -1) {
 				// suspend goal and attack
-				ailog->info() << "pointer " << myid << " suspending goal due to good target" << std::endl;
+				LOG_INFO << "pointer " << myid << " suspending goal due to good target" << std::endl;
 				if (goal) {
 					unitai->SuspendCurrentGoal();
 					if (suspendedPointerGoals.find(goal->id) == suspendedPointerGoals.end()) {
@@ -885,7 +834,7 @@ void TopLevelAI::FindPointerTargets()
 				Command attack;
 				attack.id = CMD_ATTACK;
 				attack.AddParam(foundid);
-				ai->cb->GiveOrder(myid, &attack);
+				ai->orders.GiveOrder(myid, attack);
 			} else {
 				// target in range and LOS not found, check for enemy bases or minifacs in range but not LOS
 				numenemies = ai->cheatcb->GetEnemyUnits(enemies, pos, 1400);
@@ -900,7 +849,7 @@ void TopLevelAI::FindPointerTargets()
 				}
 
 				if (foundid != -1) {
-					ailog->info() << "pointer " << myid << " suspending goal due to out-of-los fac target" << std::endl;
+					LOG_INFO << "pointer " << myid << " suspending goal due to out-of-los fac target" << std::endl;
 					if (goal) {
 						unitai->SuspendCurrentGoal();
 						if (suspendedPointerGoals.find(goal->id) == suspendedPointerGoals.end()) {
@@ -916,12 +865,12 @@ void TopLevelAI::FindPointerTargets()
 					attack.AddParam(nmypos.x);
 					attack.AddParam(nmypos.y);
 					attack.AddParam(nmypos.z);
-					ai->cb->GiveOrder(myid, &attack);
+					ai->orders.GiveOrder(myid, attack);
 				}
 				else if (smallTargets >= 1
 						&& (randint(1, 20) < smallTargets || ai->influence->GetAtXY(pos.x, pos.z) < 0)) { // FIXME move constant to data
 					// if there is a lot of enemies nearby, suspend current goal and stop
-					ailog->info() << "pointer " << myid << " suspending goal due to danger" << std::endl;
+					LOG_INFO << "pointer " << myid << " suspending goal due to danger" << std::endl;
 					if (goal) {
 						unitai->SuspendCurrentGoal();
 						if (suspendedPointerGoals.find(goal->id) == suspendedPointerGoals.end()) {
@@ -934,20 +883,19 @@ void TopLevelAI::FindPointerTargets()
 
 					Command stop;
 					stop.id = CMD_STOP;
-					ai->cb->GiveOrder(myid, &stop);
+					ai->orders.GiveOrder(myid, stop);
 				} else {
 					// continue goal if it was aborted recently
 					// TODO keep account of which goals were suspended here
 
 					if (goal && goal->is_suspended() && suspendedPointerGoals.find(goal->id) != suspendedPointerGoals.end()) {
-						ailog->info() << "pointer " << myid << " continuing goal after suspension" << std::endl;
+						LOG_INFO << "pointer " << myid << " continuing goal after suspension" << std::endl;
 						ai->GetUnit(myid)->ai->ContinueCurrentGoal();
 					}
 				}
 			}
 		}
 	}
-	ailog->info() << __FUNCTION__ << " took " << t.elapsed() << std::endl;
 }
 
 
@@ -999,9 +947,9 @@ void TopLevelAI::DispatchPackets()
 	c.AddParam(pos.x);
 	c.AddParam(pos.y);
 	c.AddParam(pos.z);
-	ai->cb->GiveOrder(chosen, &c);
+	ai->orders.GiveOrder(chosen, c);
 	const UnitDef* ud = ai->cb->GetUnitDef(chosen);
-	ailog->info() << "dispatching packets to " << pos << " from unit " << chosen << " " << ud->name << std::endl;
+	LOG_INFO << "dispatching packets to " << pos << " from unit " << chosen << " " << ud->name << std::endl;
 }
 
 
@@ -1044,7 +992,7 @@ void TopLevelAI::AssignUnitToGroup(Unit* unit)
 
 	groups[currentAssignGroup].AssignUnit(unit);
 
-	ailog->info() << "unit " << unit->id << " assigned to combat group " << currentAssignGroup << std::endl;
+	LOG_INFO << "unit " << unit->id << " assigned to combat group " << currentAssignGroup << std::endl;
 }
 
 //////////////////////////////////////////////////////////////////////////////////////
@@ -1064,8 +1012,8 @@ void TopLevelAI::HandleExpansionCommands(Unit* expansion)
 	build.id = -expansion->ai->FindSpamUnitDefId();
 	assert(build.id < 0);
 
-	ai->cb->GiveOrder(expansion->id, &repeat);
-	ai->cb->GiveOrder(expansion->id, &build);
+	ai->orders.GiveOrder(expansion->id, repeat);
+	ai->orders.GiveOrder(expansion->id, build);
 }
 
 
@@ -1079,19 +1027,19 @@ void TopLevelAI::HandleBaseStartCommands(Unit* base)
 	build.id = -base->ai->FindSpamUnitDefId();
 	assert(build.id < 0);
 	
-	ai->cb->GiveOrder(base->id, &build);
-	ai->cb->GiveOrder(base->id, &build);
-	ai->cb->GiveOrder(base->id, &build);
+	ai->orders.GiveOrder(base->id, build);
+	ai->orders.GiveOrder(base->id, build);
+	ai->orders.GiveOrder(base->id, build);
 }
 
 
 void TopLevelAI::RetreatGroup(UnitGroupAI *group, const float3 &dest)
 {
-	Goal* goal = Goal::GetGoal(Goal::CreateGoal(10, RETREAT));
+	Goal* goal = goalRegistry->GetGoal(goalRegistry->CreateGoal(10, RETREAT));
 	goal->params.push_back(dest);
 
 	goal->timeoutFrame = ai->cb->GetCurrentFrame()
-		+ ai->python->GetIntValue("retreatGroupTimeout", 15*GAME_SPEED);
+		+ ai->config.retreatGroupTimeout;
 	group->AddGoal(goal);
 }
 
@@ -1113,9 +1061,11 @@ void TopLevelAI::UnitIdle(Unit* unit)
 		FindBaseBuildGoals();
 	
 	if (unit->ai) {
-		Goal* g = Goal::GetGoal(unit->ai->currentGoalId);
+		Goal* g = goalRegistry->GetGoal(unit->ai->currentGoalId);
 		if (g && !g->is_suspended())
 			unit->ai->CompleteCurrentGoal();
+		// pick the next goal now rather than on its next update
+		unit->ai->WakeUp();
 	}
 }
 
@@ -1137,18 +1087,20 @@ void TopLevelAI::UnitDamaged(Unit* unit, int attackerId, float damage, float3 di
 	// add defend goal
 	if (unit->last_attacked_frame + 20*GAME_SPEED < frameNum
 				&& (unit->is_base || unit->is_expansion || ud->name == "pointer")) {
-		Goal* goal = Goal::GetGoal(Goal::CreateGoal(15 + unit->is_base, DEFEND_AREA));
+		Goal* goal = goalRegistry->GetGoal(goalRegistry->CreateGoal(15 + unit->is_base, DEFEND_AREA));
 		if (attackerId > 0) {
 			goal->params.push_back(ai->cheatcb->GetUnitPos(attackerId));
 		} else {
 			goal->params.push_back(ai->cb->GetUnitPos(unit->id));
 		}
 		goal->timeoutFrame = frameNum + GAME_SPEED*20;
-		ailog->info() << "adding DEFEND goal " << goal->id << std::endl;
+		LOG_INFO << "adding DEFEND goal " << goal->id << std::endl;
 		AddGoal(goal);
 	}
 	
 	unit->last_attacked_frame = frameNum;
+	if (unit->ai)
+		unit->ai->WakeUp();
 }
 
 
@@ -1160,7 +1112,7 @@ void TopLevelAI::EnemyDestroyed(int enemy, Unit* attacker)
 	if (!ud || Unit::IsBase(ud) || Unit::IsExpansion(ud) || Unit::IsSuperWeapon(ud)) {
 		// recalculate attack goals
 		float3 midpos = groups[currentBattleGroup].GetGroupMidPos();
-		float importantRadius = ai->python->GetFloatValue("importantRadius", 1000);
+		float importantRadius = ai->config.importantRadius;
 		if (!ImportantTargetInRadius(midpos, importantRadius)) {
 			FindBattleGroupGoals();
 		}
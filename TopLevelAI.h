@@ -5,6 +5,7 @@
 
 #include "GoalProcessor.h"
 #include "UnitGroupAI.h"
+#include "ExpansionPlanner.h"
 
 class BaczekKPAI;
 
@@ -39,6 +40,10 @@ public:
 	int builderRetreatGoalId;
 	int queuedConstructors;
 
+	std::vector<int> scheduledTasks; //<! FrameScheduler task ids
+
+	ExpansionPlanner planner;
+
 	goal_process_t ProcessGoal(Goal* g);
 	void Update();
 
@@ -50,9 +55,12 @@ public:
 	void InitBattleGroups();
 
 	void FindGoals();
+	void DispatchAndFindGoals();
+	void StepPlanner(int frameNum);
 
-	void FindGoalsExpansion(std::vector<float3>& badSpots);
-	void FindGoalsRetreatBuilders(std::vector<float3>& badSpots);
+	void ApplyExpansionPlan(const ExpansionPlanner::Plan& plan);
+	void RemoveGoalsOnBadSpots(const std::vector<float3>& badSpots);
+	void FindGoalsRetreatBuilders();
 	void FindGoalsBuildConstructors();
 	
 	void FindBaseBuildGoals();
@@ -2,19 +2,25 @@
 #include "Log.h"
 #include "Unit.h"
 #include "UnitAI.h"
+#include "UnitDispatcher.h"
 #include "Goal.h"
 #include "RNG.h"
 
 UnitAI::UnitAI(BaczekKPAI* ai, Unit* owner):
+		GoalProcessor(&ai->goalRegistry),
 		owner(owner),
 		ai(ai), 
 		currentGoalId(-1),
-		stuckInBaseCnt(0)
+		stuckInBaseCnt(0),
+		dispatcher(0), bucket(-1), bucketIndex(-1),
+		wakeupPending(false)
 {
 }
 
 UnitAI::~UnitAI(void)
 {
+	if (dispatcher)
+		dispatcher->Remove(this);
 }
 
 
@@ -41,13 +47,13 @@ bool operator==(const UnitAI& a, const UnitAI& b)
 struct on_complete_clean_current_goal : std::unary_function<Goal&, void> {
 	UnitAI* ai;
 	on_complete_clean_current_goal(UnitAI* uai):ai(uai) {}
-	void operator()(Goal& goal) { ai->currentGoalId = -1; ailog->info() << "cleaning currentGoal on " << ai->owner->id << std::endl; }
+	void operator()(Goal& goal) { ai->currentGoalId = -1; LOG_DEBUG << "cleaning currentGoal on " << ai->owner->id << std::endl; }
 };
 
 struct on_complete_clean_producing : std::unary_function<Goal&, void> {
 	Unit* unit;
 	on_complete_clean_producing(Unit* u):unit(u) {}
-	void operator()(Goal& goal) { unit->is_producing = false; ailog->info() << "cleaning is_producing on " << unit->id << std::endl; }
+	void operator()(Goal& goal) { unit->is_producing = false; LOG_DEBUG << "cleaning is_producing on " << unit->id << std::endl; }
 };
 
 
@@ -62,7 +68,7 @@ GoalProcessor::goal_process_t UnitAI::ProcessGoal(Goal* goal)
 	}
 
 	if (currentGoalId >= 0) {
-		Goal* current = Goal::GetGoal(currentGoalId);
+		Goal* current = goalRegistry->GetGoal(currentGoalId);
 		if (current) {
 			if (current->is_executing() && current->priority >= goal->priority) {
 				return PROCESS_BREAK;
@@ -78,23 +84,23 @@ GoalProcessor::goal_process_t UnitAI::ProcessGoal(Goal* goal)
 		return PROCESS_BREAK;
 	}
 
-	ailog->info() << "EXECUTE GOAL: Unit " << owner->id << " executing goal " << goal->id << " type " << goal->type << std::endl;
+	LOG_DEBUG << "EXECUTE GOAL: Unit " << owner->id << " executing goal " << goal->id << " type " << goal->type << std::endl;
 
 	switch (goal->type) {
 		case BUILD_EXPANSION: {
 			if (!owner->is_constructor) {
-				ailog->error() << "BUILD_EXPANSION issued to non-constructor unit" << std::endl;
+				LOG_ERROR << "BUILD_EXPANSION issued to non-constructor unit" << std::endl;
 				return PROCESS_POP_CONTINUE;
 			}
 			Command c;
 			c.id = -FindExpansionUnitDefId();
 			assert(c.id);
-			assert(!goal->params.empty());
-			const float3& param = boost::get<float3>(goal->params[0]);
+			assert(!goal->params.empty() && goal->params[0].is_float3());
+			const float3 param = goal->params[0].as_float3();
 			c.params.push_back(param.x);
 			c.params.push_back(param.y);
 			c.params.push_back(param.z);
-			ai->cb->GiveOrder(owner->id, &c);
+			GiveOrder(c);
 			goal->OnComplete(on_complete_clean_current_goal(this));
 			goal->OnAbort(on_complete_clean_current_goal(this));
 			goal->OnComplete(on_complete_clean_producing(this->owner));
@@ -107,7 +113,7 @@ GoalProcessor::goal_process_t UnitAI::ProcessGoal(Goal* goal)
 
 		case BUILD_CONSTRUCTOR: {
 			if (!owner->is_base) {
-				ailog->error() << "BUILD_CONSTRUCTOR issued to non-base unit" << std::endl;
+				LOG_ERROR << "BUILD_CONSTRUCTOR issued to non-base unit" << std::endl;
 				return PROCESS_POP_CONTINUE;
 			}
 			if (goal->is_executing()) {
@@ -115,7 +121,7 @@ GoalProcessor::goal_process_t UnitAI::ProcessGoal(Goal* goal)
 			}
 			Command c;
 			c.id = -FindConstructorUnitDefId();
-			ai->cb->GiveOrder(owner->id, &c);
+			GiveOrder(c);
 			// FIXME XXX no way to track goal progress!
 			goal->complete();
 			return PROCESS_BREAK;
@@ -124,21 +130,21 @@ GoalProcessor::goal_process_t UnitAI::ProcessGoal(Goal* goal)
 		case MOVE:
 		case RETREAT: {
 			if (goal->params.empty()) {
-				ailog->error() << "no params on RETREAT or MOVE goal" << std::endl;
+				LOG_ERROR << "no params on RETREAT or MOVE goal" << std::endl;
 				return PROCESS_POP_CONTINUE;
 			}
-			float3* param = boost::get<float3>(&goal->params[0]);
-			if (!param) {
-				ailog->error() << "invalid param on RETREAT or MOVE goal" << std::endl;
+			if (!goal->params[0].is_float3()) {
+				LOG_ERROR << "invalid param on RETREAT or MOVE goal" << std::endl;
 				return PROCESS_POP_CONTINUE;
 			}
+			const float3 param = goal->params[0].as_float3();
 			Command c;
 			c.id = CMD_MOVE;
 			// TODO formation offset
-			c.AddParam(param->x);
-			c.AddParam(param->y);
-			c.AddParam(param->z);
-			ai->cb->GiveOrder(owner->id, &c);
+			c.AddParam(param.x);
+			c.AddParam(param.y);
+			c.AddParam(param.z);
+			GiveOrder(c);
 			goal->OnComplete(on_complete_clean_current_goal(this));
 			goal->OnAbort(on_complete_clean_current_goal(this));
 			goal->start();
@@ -149,29 +155,29 @@ GoalProcessor::goal_process_t UnitAI::ProcessGoal(Goal* goal)
 
 		case ATTACK: {
 			if (goal->params.empty()) {
-				ailog->error() << "no params on ATTACK goal" << std::endl;
+				LOG_ERROR << "no params on ATTACK goal" << std::endl;
 				return PROCESS_POP_CONTINUE;
 			}
-			float3* paramf = boost::get<float3>(&goal->params[0]);
-			int* parami = boost::get<int>(&goal->params[0]);
-			if (!paramf && !parami) {
-				ailog->error() << "invalid param on ATTACK goal" << std::endl;
+			const Goal::param_type& param = goal->params[0];
+			if (!param.is_float3() && !param.is_int()) {
+				LOG_ERROR << "invalid param on ATTACK goal" << std::endl;
 				return PROCESS_POP_CONTINUE;
 			}
 			Command c;
-			if (paramf) { // attack move
+			if (param.is_float3()) { // attack move
+				const float3 pos = param.as_float3();
 				c.id = CMD_FIGHT;
-				c.AddParam(paramf->x);
-				c.AddParam(paramf->y);
-				c.AddParam(paramf->z);
+				c.AddParam(pos.x);
+				c.AddParam(pos.y);
+				c.AddParam(pos.z);
 				// it's good to have some units move up close
-				if (randfloat() < ai->python->GetFloatValue("pr_MOVEOnAttack", 0.1))
+				if (randfloat() < ai->config.pr_MOVEOnAttack)
 					c.id = CMD_MOVE;
 			} else { // attack unit
 				c.id = CMD_ATTACK;
-				c.AddParam(*parami);
+				c.AddParam(param.as_int());
 			}
-			ai->cb->GiveOrder(owner->id, &c);
+			GiveOrder(c);
 			currentGoalId = goal->id;
 			goal->OnComplete(on_complete_clean_current_goal(this));
 			goal->OnAbort(on_complete_clean_current_goal(this));
@@ -189,36 +195,49 @@ GoalProcessor::goal_process_t UnitAI::ProcessGoal(Goal* goal)
 
 void UnitAI::Update()
 {
-	int frameNum = ai->cb->GetCurrentFrame();
-
-	int phase = frameNum % GAME_SPEED;
-
-	if (phase == (owner ? owner->id%GAME_SPEED : 0)) {
-		if (owner) {
-			const UnitDef* ud = ai->cb->GetUnitDef(owner->id);
-			if (ud && ud->name == "worm") {
-				// set firestate to fire at will till a better solution is available
-				Command c;
-				c.id = CMD_FIRE_STATE;
-				c.AddParam(2);
-				ai->cb->GiveOrder(owner->id, &c);
-			}
-		}
+	Update(ai->cb->GetCurrentFrame());
+}
 
+void UnitAI::Update(int frameNum)
+{
+	if (!owner)
+		return;
 
-		std::sort(goals.begin(), goals.end(), goal_priority_less());
-		//DumpGoalStack("Unit");
-		CheckContinueGoal();
-		ProcessGoalStack(frameNum);
-	} else if (phase == 1) {
-		CheckBuildValid();
+	const UnitDef* ud = ai->cb->GetUnitDef(owner->id);
+	if (ud && ud->name == "worm") {
+		// set firestate to fire at will till a better solution is available
+		Command c;
+		c.id = CMD_FIRE_STATE;
+		c.AddParam(2);
+		GiveOrder(c);
 	}
 
-	if (frameNum % GAME_SPEED == owner->id % GAME_SPEED) {
-		CheckStandingInBase();
-		if (owner->is_spam)
-			CheckSpamTargets();
-	}
+	ProcessGoals(frameNum);
+	CheckBuildValid();
+
+	CheckStandingInBase();
+	if (owner->is_spam)
+		CheckSpamTargets();
+}
+
+void UnitAI::ProcessGoals(int frameNum)
+{
+	goalRegistry->SortByPriority(goals);
+	//DumpGoalStack("Unit");
+	CheckContinueGoal();
+	ProcessGoalStack(frameNum);
+}
+
+void UnitAI::WakeUp()
+{
+	if (dispatcher && owner)
+		dispatcher->WakeUp(this);
+}
+
+void UnitAI::GiveOrder(const Command& c)
+{
+	assert(owner);
+	ai->orders.GiveOrder(owner->id, c);
 }
 
 
@@ -228,14 +247,14 @@ void UnitAI::CheckContinueGoal()
 		return;
 	}
 
-	Goal* current = Goal::GetGoal(currentGoalId);
+	Goal* current = goalRegistry->GetGoal(currentGoalId);
 	if (!current) {
 		currentGoalId = -1;
 		return;
 	}
 
 	if (current->is_restarted()) {
-		ailog->info() << "restarting goal " << current->id << " in CheckContinueGoal" << std::endl;
+		LOG_INFO << "restarting goal " << current->id << " in CheckContinueGoal" << std::endl;
 		ProcessGoal(current);
 	}
 }
@@ -248,10 +267,12 @@ void UnitAI::OwnerKilled()
 
 	currentGoalId = -1;
 	BOOST_FOREACH(int gid, goals) {
-		Goal* g = Goal::GetGoal(gid);
+		Goal* g = goalRegistry->GetGoal(gid);
 		if (g)
-			Goal::RemoveGoal(g);
+			goalRegistry->RemoveGoal(g);
 	}
+	if (dispatcher)
+		dispatcher->Remove(this);
 	owner = 0;
 }
 
@@ -332,7 +353,7 @@ int UnitAI::FindSpamUnitDefId()
 void UnitAI::CompleteCurrentGoal()
 {
 	if (currentGoalId >= 0) {
-		Goal* currentGoal = Goal::GetGoal(currentGoalId);
+		Goal* currentGoal = goalRegistry->GetGoal(currentGoalId);
 		if (currentGoal && !currentGoal->is_finished()) {
 			currentGoal->complete();
 		}
@@ -344,7 +365,7 @@ void UnitAI::CompleteCurrentGoal()
 void UnitAI::SuspendCurrentGoal()
 {
 	if (currentGoalId >= 0) {
-		Goal* currentGoal = Goal::GetGoal(currentGoalId);
+		Goal* currentGoal = goalRegistry->GetGoal(currentGoalId);
 		if (currentGoal && !currentGoal->is_finished()) {
 			currentGoal->suspend();
 		}
@@ -354,9 +375,10 @@ void UnitAI::SuspendCurrentGoal()
 void UnitAI::ContinueCurrentGoal()
 {
 	if (currentGoalId >= 0) {
-		Goal* currentGoal = Goal::GetGoal(currentGoalId);
+		Goal* currentGoal = goalRegistry->GetGoal(currentGoalId);
 		if (currentGoal && currentGoal->is_suspended()) {
 			currentGoal->continue_();
+			WakeUp();
 		}
 	}
 }
@@ -386,19 +408,20 @@ void UnitAI::CheckBuildValid()
 	if (!enemies.empty()) {
 		// we shouldn't be building here, abort
 		// unless of course it wasn't our goal...
-		Goal* goal = Goal::GetGoal(currentGoalId);
-		if (goal && goal->params.size() >= 1 && goal->type == BUILD_EXPANSION) {
-			float3& param = boost::get<float3>(goal->params[0]);
+		Goal* goal = goalRegistry->GetGoal(currentGoalId);
+		if (goal && goal->params.size() >= 1 && goal->type == BUILD_EXPANSION
+				&& goal->params[0].is_float3()) {
+			const float3 param = goal->params[0].as_float3();
 			if (param.SqDistance2D(pos) < 8*8) {
-				ailog->info() << "aborting construction goal at " << pos << " for builder "
+				LOG_INFO << "aborting construction goal at " << pos << " for builder "
 					<< owner->id << " (goal id " << goal->id << ")" << std::endl;
 				goal->abort();
 				Command stop;
 				stop.id = CMD_STOP;
-				ai->cb->GiveOrder(owner->id, &stop);
+				GiveOrder(stop);
 
 				for (std::vector<int>::iterator it = enemies.begin(); it != enemies.end(); ++it) {
-					ailog->info() << "  enemy at " << ai->cheatcb->GetUnitPos(*it) << std::endl;
+					LOG_INFO << "  enemy at " << ai->cheatcb->GetUnitPos(*it) << std::endl;
 					ai->CreateLineFigure(pos+float3(0, 100, 0), ai->cheatcb->GetUnitPos(*it)+float3(0, 100, 0), 5, 20, 900, 0);
 				}
 			}
@@ -419,7 +442,7 @@ void UnitAI::CheckSpamTargets()
 
 	int num;
 	int enemies[MAX_UNITS];
-	float radius = ai->python->GetFloatValue("spam_radius", 384);
+	float radius = ai->config.spam_radius;
 	float3 pos = ai->cb->GetUnitPos(owner->id);
 	num = ai->cheatcb->GetEnemyUnits(enemies, pos, radius);
 	int found = -1;
@@ -441,7 +464,7 @@ void UnitAI::CheckSpamTargets()
 		c.AddParam(CMD_ATTACK);
 		c.AddParam(0);
 		c.AddParam(found);
-		ai->cb->GiveOrder(owner->id, &c);
+		GiveOrder(c);
 	}
 }
 
@@ -467,12 +490,12 @@ void UnitAI::CheckStandingInBase()
 	int num;
 	float3 pos = ai->cb->GetUnitPos(owner->id);
 
-	num = ai->cb->GetFriendlyUnits(friends, pos, ai->python->GetFloatValue("baseSearchRadius", 16));
+	num = ai->cb->GetFriendlyUnits(friends, pos, ai->config.baseSearchRadius);
 	for (int i = 0; i<num; ++i) {
 		Unit* u = ai->GetUnit(friends[i]);
 		if (u && u->is_base) {
 			// unstuck after a bit of time has passed
-			if (stuckInBaseCnt < ai->python->GetIntValue("maxBaseStuckCount", 3)) {
+			if (stuckInBaseCnt < ai->config.maxBaseStuckCount) {
 				++stuckInBaseCnt;
 				break;
 			}
@@ -495,7 +518,7 @@ void UnitAI::CheckStandingInBase()
 			c.AddParam(newpos.x);
 			c.AddParam(newpos.y);
 			c.AddParam(newpos.z);
-			ai->cb->GiveOrder(owner->id, &c);
+			GiveOrder(c);
 			break;
 		}
 	}
@@ -506,7 +529,7 @@ bool UnitAI::CheckPosInBase(float3 pos)
 	int friends[MAX_UNITS];
 	int num;
 
-	num = ai->cb->GetFriendlyUnits(friends, pos, ai->python->GetFloatValue("baseSearchRadius", 16));
+	num = ai->cb->GetFriendlyUnits(friends, pos, ai->config.baseSearchRadius);
 	for (int i = 0; i<num; ++i) {
 		Unit* u = ai->GetUnit(friends[i]);
 		if (u && u->is_base) {
@@ -6,6 +6,8 @@
 
 class BaczekKPAI;
 class Unit;
+class UnitDispatcher;
+struct Command;
 
 class UnitAI :
 	public GoalProcessor
@@ -23,10 +25,23 @@ public:
 
 	int stuckInBaseCnt;
 
+	// bookkeeping of the dispatcher calling Update
+	UnitDispatcher* dispatcher;
+	int bucket;
+	int bucketIndex;
+	bool wakeupPending;
+
+
 	on_killed_sig onKilled;
 
 	goal_process_t ProcessGoal(Goal* g);
 	void Update();
+	/// periodic update, called by dispatcher once a second
+	void Update(int frameNum);
+	void ProcessGoals(int frameNum);
+	/// have goals processed on the next frame instead of waiting for Update
+	void WakeUp();
+	void GiveOrder(const Command& c);
 	void OwnerKilled();
 
 	connection OnKilled(on_killed_sig::slot_function_type f)
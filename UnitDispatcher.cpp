@@ -0,0 +1,132 @@
+#include <cassert>
+#include <algorithm>
+
+#include "Unit.h"
+#include "UnitAI.h"
+#include "UnitDispatcher.h"
+
+
+UnitDispatcher::UnitDispatcher():
+		count(0), running(false), needsCompact(false)
+{
+}
+
+UnitDispatcher::~UnitDispatcher()
+{
+	for (int i = 0; i < BUCKETS; ++i) {
+		for (size_t j = 0; j < buckets[i].size(); ++j) {
+			if (buckets[i][j])
+				buckets[i][j]->dispatcher = 0;
+		}
+	}
+}
+
+
+int UnitDispatcher::BucketOf(UnitAI* unit)
+{
+	assert(unit->owner);
+	return unit->owner->id % BUCKETS;
+}
+
+void UnitDispatcher::Add(UnitAI* unit)
+{
+	assert(unit);
+	if (unit->dispatcher == this)
+		return;
+	if (unit->dispatcher)
+		unit->dispatcher->Remove(unit);
+
+	Bucket& bucket = buckets[BucketOf(unit)];
+	unit->dispatcher = this;
+	unit->bucket = BucketOf(unit);
+	unit->bucketIndex = bucket.size();
+	unit->wakeupPending = false;
+	bucket.push_back(unit);
+	++count;
+}
+
+void UnitDispatcher::Remove(UnitAI* unit)
+{
+	assert(unit);
+	if (unit->dispatcher != this)
+		return;
+
+	Bucket& bucket = buckets[unit->bucket];
+	assert(bucket[unit->bucketIndex] == unit);
+	if (running) {
+		bucket[unit->bucketIndex] = 0;
+		needsCompact = true;
+	} else {
+		// swap with the last one to keep the array dense
+		UnitAI* last = bucket.back();
+		bucket[unit->bucketIndex] = last;
+		last->bucketIndex = unit->bucketIndex;
+		bucket.pop_back();
+	}
+
+	// the unit may still be queued even if it was updated since waking up
+	Bucket::iterator it = std::find(woken.begin(), woken.end(), unit);
+	if (it != woken.end())
+		*it = 0;
+	unit->wakeupPending = false;
+
+	unit->dispatcher = 0;
+	--count;
+}
+
+void UnitDispatcher::WakeUp(UnitAI* unit)
+{
+	assert(unit);
+	assert(unit->dispatcher == this);
+	if (unit->wakeupPending)
+		return;
+	unit->wakeupPending = true;
+	woken.push_back(unit);
+}
+
+
+void UnitDispatcher::Run(int frame)
+{
+	running = true;
+
+	Bucket& bucket = buckets[frame % BUCKETS];
+	// Update may add units to the end, these wait for their next turn
+	size_t size = bucket.size();
+	for (size_t i = 0; i < size; ++i) {
+		UnitAI* unit = bucket[i];
+		if (!unit)
+			continue;
+		// a full update processes goals too
+		unit->wakeupPending = false;
+		unit->Update(frame);
+	}
+
+	// wakeups can be queued while processing, so don't cache the size
+	for (size_t i = 0; i < woken.size(); ++i) {
+		UnitAI* unit = woken[i];
+		if (!unit || !unit->wakeupPending)
+			continue;
+		unit->wakeupPending = false;
+		unit->ProcessGoals(frame);
+	}
+	woken.clear();
+
+	running = false;
+	if (needsCompact) {
+		for (int i = 0; i < BUCKETS; ++i)
+			Compact(buckets[i]);
+		needsCompact = false;
+	}
+}
+
+void UnitDispatcher::Compact(Bucket& bucket)
+{
+	size_t out = 0;
+	for (size_t i = 0; i < bucket.size(); ++i) {
+		if (!bucket[i])
+			continue;
+		bucket[i]->bucketIndex = out;
+		bucket[out++] = bucket[i];
+	}
+	bucket.resize(out);
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+class UnitAI;
+
+/// calls UnitAI updates spread over frames
+///
+/// Each unit sits in one of BUCKETS dense arrays chosen by its id and is
+/// updated once every BUCKETS frames, so a frame only touches its own
+/// bucket. Units that need attention right away (idle, damaged, goal
+/// restarted) are woken up and get their goals processed on the next Run.
+class UnitDispatcher
+{
+public:
+	UnitDispatcher();
+	~UnitDispatcher();
+
+	static const int BUCKETS = 30; //<! one per frame of a game second
+
+	void Add(UnitAI* unit);
+	void Remove(UnitAI* unit);
+	void WakeUp(UnitAI* unit);
+
+	void Run(int frame);
+
+	size_t size() const { return count; }
+
+protected:
+	typedef std::vector<UnitAI*> Bucket;
+
+	Bucket buckets[BUCKETS];
+	Bucket woken;
+	size_t count;
+
+	/// units removed while running are nulled out and compacted afterwards
+	bool running;
+	bool needsCompact;
+
+	static int BucketOf(UnitAI* unit);
+	void Compact(Bucket& bucket);
+};
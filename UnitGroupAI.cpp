@@ -1,20 +1,39 @@
+#include <algorithm>
+#include <cmath>
 #include <boost/shared_ptr.hpp>
+#include <boost/bind.hpp>
 #include <boost/foreach.hpp>
-#include <boost/timer.hpp>
 
 #include "Sim/MoveTypes/MoveInfo.h"
 
 #include "Log.h"
+#include "Profiler.h"
 #include "BaczekKPAI.h"
 #include "Unit.h"
 #include "UnitGroupAI.h"
 #include "Goal.h"
 #include "UnitAI.h"
 #include "RNG.h"
+#include "Formation.h"
 
 
 using boost::shared_ptr;
 
+UnitGroupAI::UnitGroupAI(BaczekKPAI *theai) :
+		GoalProcessor(&theai->goalRegistry),
+		ai(theai), rallyPoint(-1, -1, -1),
+		dir(1, 0, 0), rightdir(0, 0, 1)
+{
+	processTaskId = ai->scheduler.AddTask("UnitGroupAI::ProcessGoals", GAME_SPEED,
+			FrameScheduler::ANY_PHASE, ai->scheduler.criticalPriority, 300,
+			boost::bind(&UnitGroupAI::ProcessGoals, this, _1));
+}
+
+UnitGroupAI::~UnitGroupAI()
+{
+	ai->scheduler.RemoveTask(processTaskId);
+}
+
 GoalProcessor::goal_process_t UnitGroupAI::ProcessGoal(Goal* goal)
 {
 	if (!goal || goal->is_finished()) {
@@ -36,8 +55,10 @@ GoalProcessor::goal_process_t UnitGroupAI::ProcessGoal(Goal* goal)
 
 		case MOVE:
 		case RETREAT:
-			if (goal->params.empty())
+			if (goal->params.empty() || !goal->params[0].is_float3()) {
+				LOG_ERROR << "invalid param on RETREAT or MOVE goal " << goal->id << std::endl;
 				return PROCESS_POP_CONTINUE;
+			}
 			ProcessRetreatMove(goal);
 			return PROCESS_BREAK;
 
@@ -54,23 +75,20 @@ GoalProcessor::goal_process_t UnitGroupAI::ProcessGoal(Goal* goal)
 	return PROCESS_CONTINUE;
 }
 
+void UnitGroupAI::ProcessGoals(int frameNum)
+{
+	CheckUnit2Goal();
+	goalRegistry->SortByPriority(goals);
+	DumpGoalStack("UnitGroupAI");
+	ProcessGoalStack(frameNum);
+}
+
 void UnitGroupAI::Update()
 {
-	boost::timer t;
-	int frameNum = ai->cb->GetCurrentFrame();
-
-	if (frameNum % 30 == 0) {
-		CheckUnit2Goal();
-		std::sort(goals.begin(), goals.end(), goal_priority_less());
-		DumpGoalStack("UnitGroupAI");
-		ProcessGoalStack(frameNum);
-	}
+	PROFILE_ZONE("UnitGroupAI::Update");
 
 	// update units
-	BOOST_FOREACH(UnitAISet::value_type& v, units) {
-		v.second->Update();
-	}
-	ailog->info() << __FUNCTION__ << " took " << t.elapsed() << std::endl;
+	unitDispatcher.Run(ai->cb->GetCurrentFrame());
 }
 
 
@@ -87,7 +105,7 @@ void UnitGroupAI::ProcessBuildConstructor(Goal* goal)
 		assert(unit);
 		if (unit->is_producing)
 			continue;
-		Goal *g = Goal::GetGoal(Goal::CreateGoal(goal->priority, BUILD_CONSTRUCTOR));
+		Goal *g = goalRegistry->GetGoal(goalRegistry->CreateGoal(goal->priority, BUILD_CONSTRUCTOR));
 		assert(g);
 		g->parent = goal->id;
 
@@ -97,7 +115,7 @@ void UnitGroupAI::ProcessBuildConstructor(Goal* goal)
 		// behaviour when subgoal changes
 		g->OnComplete(CompleteGoal(*goal));
 
-		ailog->info() << "unit " << unit->id << " assigned to producing a constructor" << std::endl;
+		LOG_INFO << "unit " << unit->id << " assigned to producing a constructor" << std::endl;
 		uai->AddGoal(g);
 		goal->start();
 		// unit found, exit loop
@@ -110,22 +128,20 @@ void UnitGroupAI::ProcessBuildExpansion(Goal* goal)
 {
 	assert(goal);
 	assert(goal->type == BUILD_EXPANSION);
-	BOOST_FOREACH(UnitAISet::value_type& v, units) {
-		UnitAIPtr uai = v.second;
+	// TODO FIXME used goals aren't freed when units assigned to them die
+	if (usedGoals.find(goal->id) != usedGoals.end())
+		return;
+	if (goal->params.empty() || !goal->params[0].is_float3()) {
+		LOG_ERROR << "BUILD_EXPANSION goal " << goal->id << " without a position" << std::endl;
+		return;
+	}
+
+	UnitAIPtr uai = ClosestFreeConstructor(goal->params[0].as_float3());
+	if (uai) {
 		Unit* unit = uai->owner;
 		assert(unit);
-		if (unit->is_producing)
-			continue;
-		if (!unit->is_constructor)
-			continue;
-		if (usedUnits.find(unit->id) != usedUnits.end())
-			continue;
-		// TODO FIXME used goals aren't freed when units assigned to them die
-		if (usedGoals.find(goal->id) != usedGoals.end())
-			continue;
-		Goal *g = Goal::GetGoal(Goal::CreateGoal(1, BUILD_EXPANSION));
+		Goal *g = goalRegistry->GetGoal(goalRegistry->CreateGoal(1, BUILD_EXPANSION));
 		assert(g);
-		assert(goal->params.size() >= 1);
 		g->parent = goal->id;
 		g->params.push_back(goal->params[0]);
 
@@ -144,7 +160,7 @@ void UnitGroupAI::ProcessBuildExpansion(Goal* goal)
 		g->OnAbort(RemoveUsedUnit(*this, unit->id));
 		g->OnAbort(RemoveUsedGoal(*this, goal->id));
 
-		ailog->info() << "unit " << unit->id << " assigned to building an expansion (goal id " << goal->id
+		LOG_INFO << "unit " << unit->id << " assigned to building an expansion (goal id " << goal->id
 			<< " " << goal->params[0] << ")" << std::endl;
 		uai->AddGoal(g);
 		goal->start();
@@ -152,8 +168,6 @@ void UnitGroupAI::ProcessBuildExpansion(Goal* goal)
 		usedGoals.insert(goal->id);
 		unit2goal[unit->id] = goal->id;
 		goal2unit[goal->id] = unit->id;
-		// unit found, exit loop
-		break;
 	}
 }
 
@@ -164,8 +178,11 @@ void UnitGroupAI::ProcessRetreatMove(Goal* goal)
 	assert(goal);
 	assert(goal->type == MOVE || goal->type == RETREAT);
 
-	// may throw
-	rallyPoint = boost::get<float3>(goal->params[0]);
+	if (goal->params.empty() || !goal->params[0].is_float3()) {
+		LOG_ERROR << "invalid param on RETREAT or MOVE goal " << goal->id << std::endl;
+		return;
+	}
+	rallyPoint = goal->params[0].as_float3();
 
 	int i = 0;
 
@@ -178,14 +195,14 @@ void UnitGroupAI::ProcessRetreatMove(Goal* goal)
 		if (used != usedUnits.end() && used->second >= goal->priority)
 			continue;
 		if (used != usedUnits.end() && used->second < goal->priority)
-			ailog->info() << "overriding move goal due to lower priority" << std::endl;
+			LOG_DEBUG << "overriding move goal due to lower priority" << std::endl;
 
 		if (uai->HaveGoalType(RETREAT, goal->priority))
 			continue;
 
 		usedUnits.insert(std::make_pair(unit->id, goal->priority));
 
-		ailog->info() << "gave " << unit->id << " RETREAT to " << rallyPoint << std::endl;
+		LOG_DEBUG << "gave " << unit->id << " RETREAT to " << rallyPoint << std::endl;
 		Goal* g = CreateRetreatGoal(*uai, goal->timeoutFrame);
 		g->parent = goal->id;
 		// behaviour when subgoal changes
@@ -227,7 +244,7 @@ void UnitGroupAI::ProcessAttack(Goal* goal)
 
 		assert(goal->params.size() >= 1);
 
-		Goal* g = Goal::GetGoal(Goal::CreateGoal(goal->priority, ATTACK));
+		Goal* g = goalRegistry->GetGoal(goalRegistry->CreateGoal(goal->priority, ATTACK));
 		g->parent = goal->id;
 		g->timeoutFrame = goal->timeoutFrame;
 		g->params.push_back(goal->params[0]);
@@ -266,7 +283,9 @@ void UnitGroupAI::AssignUnit(Unit* unit)
 	}
 	UnitAIPtr uai = unit->ai;
 	assert(uai);
-	units.insert(UnitAISet::value_type(unit->id, uai));
+	if (units.insert(UnitAISet::value_type(unit->id, uai)).second)
+		stats.frame = -1;
+	unitDispatcher.Add(uai.get());
 	//uai->OnKilled(boost::bind(&UnitGroupAI::RemoveUnitAI, this)); // crashes msvc9 lol
 	uai->OnKilled(OnKilledHandler(*this));
 }
@@ -274,28 +293,31 @@ void UnitGroupAI::AssignUnit(Unit* unit)
 void UnitGroupAI::RemoveUnit(Unit* unit)
 {
 	assert(unit);
-	units.erase(unit->id);
+	if (unit->ai)
+		unitDispatcher.Remove(unit->ai.get());
+	if (units.erase(unit->id))
+		stats.frame = -1;
 	usedUnits.erase(unit->id);
 }
 
 void UnitGroupAI::RemoveUnitAI(UnitAI& unitAi)
 {
 	assert(unitAi.owner);
-	ailog->info() << "removing unit " << unitAi.owner->id << " from group" << std::endl;
+	LOG_INFO << "removing unit " << unitAi.owner->id << " from group" << std::endl;
 	RemoveUnit(unitAi.owner);
 }
 
 void UnitGroupAI::RetreatUnusedUnits()
 {
-	boost::timer t;
+	PROFILE_ZONE("UnitGroupAI::RetreatUnusedUnits");
 
 	if (!rallyPoint.IsInBounds()) {
-		ailog->info() << "cannot retreat unit group, rally point not set" << std::endl;
+		LOG_INFO << "cannot retreat unit group, rally point not set" << std::endl;
 		return;
 	}
 
 	for (std::map<int, int>::iterator it = usedUnits.begin(); it != usedUnits.end(); ++it) {
-		ailog->info() << it->first << " is used" << std::endl;
+		LOG_DEBUG << it->first << " is used" << std::endl;
 	}
 
 	for (UnitAISet::iterator it = units.begin(); it != units.end(); ++it) {
@@ -305,20 +327,18 @@ void UnitGroupAI::RetreatUnusedUnits()
 			&& rallyPoint.SqDistance2D(ai->cb->GetUnitPos(it->first)) > 20*20*SQUARE_SIZE*SQUARE_SIZE // and not close to rally point
 			&& !it->second->HaveGoalType(RETREAT)) {	 // and doesn't have a retreat goal
 			// retreat
-			ailog->info() << "retreating unused " << it->first << std::endl;
+			LOG_DEBUG << "retreating unused " << it->first << std::endl;
 			Goal* newgoal = CreateRetreatGoal(*it->second, 15*GAME_SPEED);
 			it->second->AddGoal(newgoal);
 		}
 	}
-
-	ailog->info() << __FUNCTION__ << " took " << t.elapsed() << std::endl;
 }
 
 
 Goal* UnitGroupAI::CreateRetreatGoal(UnitAI &uai, int timeoutFrame)
 {
 	Unit* unit = uai.owner;
-	Goal *g = Goal::GetGoal(Goal::CreateGoal(1, RETREAT));
+	Goal *g = goalRegistry->GetGoal(goalRegistry->CreateGoal(1, RETREAT));
 	assert(g);
 	g->timeoutFrame = timeoutFrame;
 	g->params.push_back(random_offset_pos(rallyPoint, SQUARE_SIZE*4, SQUARE_SIZE*4*sqrt((float)units.size())));
@@ -334,13 +354,13 @@ bool UnitGroupAI::CheckUnit2Goal()
 		assert(unit);
 		assert(!unit->is_killed);
 		assert(it->first == goal2unit[it->second]);
-		Goal* unitgoal = Goal::GetGoal(unit->ai->currentGoalId);
+		Goal* unitgoal = goalRegistry->GetGoal(unit->ai->currentGoalId);
 		assert(unitgoal);
 		assert(unitgoal->parent == it->second);
 	}
 	// check goal2unit
 	for (std::map<int, int>::iterator it = goal2unit.begin(); it != goal2unit.end(); ++it) {
-		Goal* goal = Goal::GetGoal(it->first);
+		Goal* goal = goalRegistry->GetGoal(it->first);
 		assert(goal);
 		assert(it->first == unit2goal[it->second]);
 		Unit* unit = ai->GetUnit(it->second);
@@ -353,100 +373,105 @@ bool UnitGroupAI::CheckUnit2Goal()
 ////////////////////////////////////////////////////////////////////
 // utils
 
-/// if unitdef is NULL, "assembler" is used
-float UnitGroupAI::SqDistanceClosestUnit(const float3& pos, int* unit, const UnitDef* unitdef)
+/// free constructor with the shortest path to pos, null if there's none
+///
+/// Lengths come from BaczekKPAI::GetPathLength, i.e. our own pathfinder for
+/// the constructors' move type, so checking every constructor is cheap. One without a path is only
+/// taken when no constructor has one, the engine may still find a way.
+UnitGroupAI::UnitAIPtr UnitGroupAI::ClosestFreeConstructor(const float3& pos)
 {
-	float min = 1e30;
-	int found_uid = -1;
-
-	if (!unitdef) {
-		unitdef = ai->cb->GetUnitDef("assembler");
-		if (!unitdef) {
-			ailog->error() << "default unitdef \"assembler\" not found in SqDistanceClosestUnit" << std::endl;
-			return -1;
-		}
-	}
+	UnitAIPtr closest;
+	UnitAIPtr fallback;
+	float minLength = 0;
 
 	BOOST_FOREACH(const UnitAISet::value_type& v, units) {
-		int id = v.first;
-		const UnitDef* ud = ai->cb->GetUnitDef(id);
-		const float size = std::max(ud->xsize, ud->zsize)*SQUARE_SIZE;
-		float3 upos = ai->cb->GetUnitPos(id);
-		float3 startpos = random_offset_pos(upos, size*1.5, size*2);
-		float tmp = ai->EstimateSqDistancePF(unitdef, startpos, pos);
-		if (tmp < min && tmp >=0) {
-			min = tmp;
-			found_uid = id;
-		} else if (tmp < 0) {
-			ailog->error() << "can't reach " << pos << " from " << startpos << std::endl;
-		}
-	}
-	
-	if (unit)
-		*unit = found_uid;
-	if (found_uid == -1)
-		min = -1;
-	return min;
-}
+		const UnitAIPtr& uai = v.second;
+		Unit* unit = uai->owner;
+		assert(unit);
+		if (unit->is_producing || !unit->is_constructor)
+			continue;
+		if (usedUnits.find(unit->id) != usedUnits.end())
+			continue;
 
-/// if unitdef is NULL, "assembler" is used
-float UnitGroupAI::DistanceClosestUnit(const float3& pos, int* unit, const UnitDef* unitdef)
-{
-	float min = 1e30;
-	int found_uid = -1;
-
-	if (!unitdef) {
-		unitdef = ai->cb->GetUnitDef("assembler");
-		if (!unitdef) {
-			ailog->error() << "default unitdef \"assembler\" not found in SqDistanceClosestUnit" << std::endl;
-			return -1;
+		const UnitDef* ud = ai->cb->GetUnitDef(unit->id);
+		float length = -1;
+		if (ud && ud->movedata)
+			length = ai->GetPathLength(ud, ai->cb->GetUnitPos(unit->id), pos);
+		if (length < 0) {
+			if (!fallback)
+				fallback = uai;
+			continue;
 		}
-	}
-
-	BOOST_FOREACH(const UnitAISet::value_type& v, units) {
-		int id = v.first;
-		const UnitDef* ud = ai->cb->GetUnitDef(id);
-		const float size = std::max(ud->xsize, ud->zsize)*SQUARE_SIZE;
-		float3 upos = ai->cb->GetUnitPos(id);
-		float3 startpos = random_offset_pos(upos, size*1.5, size*2);
-		float tmp = ai->cb->GetPathLength(startpos, pos, unitdef->movedata->pathType);
-		if (tmp < min && tmp >=0) {
-			min = tmp;
-			found_uid = id;
-		} else if (tmp < 0) {
-			ailog->error() << "can't reach " << pos << " from " << startpos << std::endl;
+		if (!closest || length < minLength) {
+			closest = uai;
+			minLength = length;
 		}
 	}
-	
-	if (unit)
-		*unit = found_uid;
-	if (found_uid == -1)
-		min = -1;
-	return min;
-}
 
+	if (!closest && fallback)
+		LOG_INFO << "no constructor has a path to " << pos << ", sending unit " << fallback->owner->id << " anyway" << std::endl;
+	return closest ? closest : fallback;
+}
 
 
-float3 UnitGroupAI::GetGroupMidPos()
+UnitGroupAI::Stats::Stats():
+		frame(-1), count(0), mid(0, 0, 0), mins(0, 0, 0), maxs(0, 0, 0),
+		health(0), maxHealth(0), spread(0)
 {
-	float3 pos(0, 0, 0);
-	if (units.empty())
-		return pos;
-
-	for (UnitAISet::iterator it = units.begin(); it != units.end(); ++it) {
-		pos += ai->cb->GetUnitPos(it->first);
-	}
-	pos /= (float)units.size();
-	return pos;
 }
 
-int UnitGroupAI::GetGroupHealth()
+const UnitGroupAI::Stats& UnitGroupAI::GetStats()
 {
-	int health = 0;
-	for (UnitAISet::iterator it = units.begin(); it != units.end(); ++it) {
-		health += ai->cb->GetUnitHealth(it->first);
+	const WorldSnapshot& world = ai->world;
+	if (stats.frame >= 0 && stats.frame == world.frame)
+		return stats;
+
+	// positions are taken relative to the first unit, squares of absolute
+	// map coordinates would cancel out in the variance below
+	float refX = 0, refZ = 0;
+	float sumX = 0, sumY = 0, sumZ = 0, sumSq = 0;
+	float minX = 1e30f, minZ = 1e30f, maxX = -1e30f, maxZ = -1e30f;
+	float health = 0, maxHealth = 0;
+	int count = 0;
+	BOOST_FOREACH(const UnitAISet::value_type& v, units) {
+		int i = world.IndexOf(v.first);
+		// units created since the snapshot are picked up next frame
+		if (i < 0 || i >= world.friendCount)
+			continue;
+		const float x = world.x[i], z = world.z[i];
+		if (count == 0) {
+			refX = x;
+			refZ = z;
+		}
+		const float dx = x - refX, dz = z - refZ;
+		sumX += dx;
+		sumY += world.y[i];
+		sumZ += dz;
+		sumSq += dx*dx + dz*dz;
+		minX = std::min(minX, x);
+		maxX = std::max(maxX, x);
+		minZ = std::min(minZ, z);
+		maxZ = std::max(maxZ, z);
+		health += world.health[i];
+		maxHealth = std::max(maxHealth, world.health[i]);
+		++count;
+	}
+
+	stats = Stats();
+	stats.frame = world.frame;
+	stats.count = count;
+	if (count > 0) {
+		const float3 meanOffset(sumX / count, 0, sumZ / count);
+		stats.mid = float3(refX + meanOffset.x, sumY / count, refZ + meanOffset.z);
+		stats.mins = float3(minX, 0, minZ);
+		stats.maxs = float3(maxX, 0, maxZ);
+		stats.health = health;
+		stats.maxHealth = maxHealth;
+		// E[|d|^2] - |E[d]|^2, d = p - first unit's position
+		float variance = sumSq / count - meanOffset.x*meanOffset.x - meanOffset.z*meanOffset.z;
+		stats.spread = std::sqrt(std::max(0.f, variance));
 	}
-	return health;
+	return stats;
 }
 
 
@@ -477,56 +502,73 @@ void UnitGroupAI::MoveTurnTowards(float3 dest, float3 point)
 
 void UnitGroupAI::SetupFormation(float3 point)
 {
-	// TODO move to data file
-	const static float aspectRatio = 4.f;
-	const static int spacing = 48;
-
-	int friends[MAX_UNITS];
-	int friend_cnt;
-
-	// perRow ** 2 / aspect ratio = total units
-	perRow = std::ceil(std::sqrt(units.size()*aspectRatio));
-	ailog->info() << "SetupFormation: perRow = " << perRow << std::endl;
-
-	// put units like this
-	//   front
-	// 3 1 0 2 4
-	// 8 6 5 7 9
-	// if there are units on chosen spots, skip that spot and just move units to the destination
-	int i = 0;
-	for (UnitAISet::iterator it = units.begin(); it != units.end(); ++i, ++it) {
-		if (it->second->currentGoalId >= 0) {
+	PROFILE_ZONE("UnitGroupAI::SetupFormation");
+	Formation formation;
+	formation.spacing = ai->config.formationSpacing;
+	formation.aspectRatio = ai->config.formationAspectRatio;
+	formation.maxExact = ai->config.formationMaxExact;
+
+	perRow = formation.RowLength(units.size());
+	LOG_INFO << "SetupFormation: perRow = " << perRow << std::endl;
+
+	// units with goals keep doing them, the rest get slots
+	std::vector<UnitAI*> freeUnits;
+	std::vector<float3> unitPos;
+	BOOST_FOREACH(UnitAISet::value_type& v, units) {
+		if (v.second->currentGoalId >= 0)
 			continue;
-		}
-		int rowPos = i%perRow;
-		int x;
-		if (rowPos & 1) { // odd variant
-			x = -(rowPos % perRow) / 2 - 1;
-		} else { // even
-			x = (rowPos % perRow) / 2; 
-		}
-		int y = i/perRow;
-		float3 dest = dir*y*-spacing + rightdir*x*spacing + point;
+		freeUnits.push_back(v.second.get());
+		unitPos.push_back(ai->cb->GetUnitPos(v.first));
+	}
+	if (freeUnits.empty())
+		return;
+
+	// skip spots where other units stand, a free unit standing on one may
+	// simply get it
+	const float slotRadius = formation.spacing*0.5f;
+	std::vector<float3> slots;
+	std::vector<int> nearby;
+	const int maxSlots = 2*units.size();
+	for (int i = 0; i < maxSlots && slots.size() < freeUnits.size(); ++i) {
+		float3 dest = formation.SlotPos(i, perRow, point, dir, rightdir);
 		dest.y = ai->GetGroundHeight(dest.x, dest.z);
 
-		// don't issue a move order if there already is a unit on the destination
-		friend_cnt = ai->cb->GetFriendlyUnits(friends, dest, spacing);
-		if (friend_cnt > 0) {
-			continue;
+		ai->world.GetFriendsInRadius(dest, slotRadius, nearby);
+		bool occupied = false;
+		BOOST_FOREACH(int idx, nearby) {
+			UnitAISet::iterator it = units.find(ai->world.id[idx]);
+			if (it == units.end() || it->second->currentGoalId >= 0) {
+				occupied = true;
+				break;
+			}
 		}
+		if (!occupied)
+			slots.push_back(dest);
+	}
+
+	std::vector<int> slotOf;
+	formation.Assign(unitPos, slots, slotOf);
+
+	for (size_t i = 0; i < freeUnits.size(); ++i) {
+		if (slotOf[i] < 0)
+			continue;
+		const float3& dest = slots[slotOf[i]];
+		// already there
+		if (unitPos[i].SqDistance2D(dest) < slotRadius*slotRadius)
+			continue;
 
-		Goal* g = Goal::GetGoal(Goal::CreateGoal(10, MOVE));
+		Goal* g = goalRegistry->GetGoal(goalRegistry->CreateGoal(10, MOVE));
 		assert(g);
 
 		g->params.push_back(dest);
-		it->second->AddGoal(g);
+		freeUnits[i]->AddGoal(g);
 	}
 }
 
 
 void UnitGroupAI::AttackMoveToSpot(float3 dest)
 {
-	Goal* g = Goal::GetGoal(Goal::CreateGoal(11, ATTACK));
+	Goal* g = goalRegistry->GetGoal(goalRegistry->CreateGoal(11, ATTACK));
 	assert(g);
 
 	g->params.push_back(dest);
@@ -536,7 +578,7 @@ void UnitGroupAI::AttackMoveToSpot(float3 dest)
 
 void UnitGroupAI::MoveToSpot(float3 dest)
 {
-	Goal* g = Goal::GetGoal(Goal::CreateGoal(10, MOVE));
+	Goal* g = goalRegistry->GetGoal(goalRegistry->CreateGoal(10, MOVE));
 	assert(g);
 
 	g->params.push_back(dest);
@@ -10,6 +10,7 @@
 #include "Goal.h"
 #include "GoalProcessor.h"
 #include "UnitAI.h"
+#include "UnitDispatcher.h"
 #include "Log.h"
 
 
@@ -18,17 +19,17 @@ class BaczekKPAI;
 class UnitGroupAI : public GoalProcessor
 {
 public:
-	UnitGroupAI(BaczekKPAI *theai) : ai(theai), rallyPoint(-1, -1, -1),
-			dir(1, 0, 0), rightdir(0, 0, 1)
-		{};
-	~UnitGroupAI() {};
+	UnitGroupAI(BaczekKPAI *theai);
+	~UnitGroupAI();
 
 	BaczekKPAI* ai;
+	int processTaskId; //<! FrameScheduler task running ProcessGoals
 
 	typedef boost::shared_ptr<UnitAI> UnitAIPtr;
 	typedef std::map<int, UnitAIPtr> UnitAISet;
 
 	UnitAISet units;
+	UnitDispatcher unitDispatcher; //<! updates units in frame buckets
 	std::map<int, int> usedUnits;
 	std::set<int> usedGoals;
 	std::map<int, int> unit2goal;
@@ -39,7 +40,7 @@ public:
 		int unitId;
 		RemoveUsedUnit(UnitGroupAI& s, int uid) : self(s), unitId(uid) {}
 		void operator()(Goal& g) {
-			ailog->info() << "removing used unit " << unitId << std::endl;
+			LOG_DEBUG << "removing used unit " << unitId << std::endl;
 			self.usedUnits.erase(unitId);
 			self.unit2goal.erase(unitId);
 		}
@@ -50,7 +51,7 @@ public:
 		int goalId;
 		RemoveUsedGoal(UnitGroupAI& s, int gid):self(s), goalId(gid) {}
 		void operator()(Goal& g) {
-			ailog->info() << "removing used goal " << goalId << std::endl;
+			LOG_DEBUG << "removing used goal " << goalId << std::endl;
 			self.usedGoals.erase(goalId);
 			self.goal2unit.erase(goalId);
 		}
@@ -74,6 +75,7 @@ public:
 	int perRow; //<? units per row in formation
 
 	goal_process_t ProcessGoal(Goal* g);
+	void ProcessGoals(int frameNum);
 	void Update();
 
 	void ProcessBuildExpansion(Goal* g);
@@ -85,14 +87,24 @@ public:
 	void RemoveUnit(Unit* unit);
 	void RemoveUnitAI(UnitAI& unitai);
 
-	// pos - point to which compute closest unit
-	// unit - returns unit id
-	// unitdef - unitdef for pathfinder purposes
-	float SqDistanceClosestUnit(const float3& pos, int* unit, const UnitDef* unitdef);
-	float DistanceClosestUnit(const float3& pos, int* unit, const UnitDef* unitdef);
+	UnitAIPtr ClosestFreeConstructor(const float3& pos);
+
+	/// aggregates over the units found in the world snapshot
+	struct Stats {
+		int frame; //<! snapshot frame, -1 if stale
+		int count;
+		float3 mid;
+		float3 mins, maxs; //<! bounding box
+		float health;
+		float maxHealth; //<! of the healthiest unit
+		float spread; //<! root mean square 2D distance from mid
+		Stats();
+	};
 
-	float3 GetGroupMidPos();
-	int GetGroupHealth();
+	/// computed on the first call in a frame, one pass over the units
+	const Stats& GetStats();
+	float3 GetGroupMidPos() { return GetStats().mid; }
+	int GetGroupHealth() { return (int)GetStats().health; }
 
 	void RetreatUnusedUnits();
 	Goal* CreateRetreatGoal(UnitAI& uai, int timeoutFrame);
@@ -103,4 +115,7 @@ public:
 	void SetupFormation(float3 point);
 	void AttackMoveToSpot(float3 dest);
 	void MoveToSpot(float3 dest);
+
+protected:
+	Stats stats;
 };
@@ -0,0 +1,105 @@
+#include "ExternalAI/IAICallback.h"
+#include "ExternalAI/IAICheats.h"
+#include "Sim/Units/UnitDef.h"
+#include <boost/foreach.hpp>
+
+#include "BaczekKPAI.h"
+#include "WorldSnapshot.h"
+
+
+WorldSnapshot::WorldSnapshot():
+		frame(-1), count(0), friendCount(0),
+		// all own units and all enemies
+		id(2*MAX_UNITS), unitDef(2*MAX_UNITS),
+		x(2*MAX_UNITS), y(2*MAX_UNITS), z(2*MAX_UNITS),
+		health(2*MAX_UNITS),
+		indexOfId(MAX_UNITS, -1),
+		cellsW(0), cellsH(0)
+{
+}
+
+
+void WorldSnapshot::Update(BaczekKPAI* ai, int frameNum)
+{
+	frame = frameNum;
+	for (int i = 0; i < count; ++i) {
+		if (id[i] >= 0 && id[i] < (int)indexOfId.size())
+			indexOfId[id[i]] = -1;
+	}
+	count = 0;
+
+	BOOST_FOREACH(int uid, ai->friends) {
+		const UnitDef* ud = ai->cb->GetUnitDef(uid);
+		float3 pos = ai->cb->GetUnitPos(uid);
+		id[count] = uid;
+		unitDef[count] = ud ? ud->id : 0;
+		x[count] = pos.x;
+		y[count] = pos.y;
+		z[count] = pos.z;
+		health[count] = ai->cb->GetUnitHealth(uid);
+		++count;
+	}
+	friendCount = count;
+
+	BOOST_FOREACH(int uid, ai->allEnemies) {
+		if ((size_t)count >= capacity())
+			break;
+		const UnitDef* ud = ai->cheatcb->GetUnitDef(uid);
+		float3 pos = ai->cheatcb->GetUnitPos(uid);
+		id[count] = uid;
+		unitDef[count] = ud ? ud->id : 0;
+		x[count] = pos.x;
+		y[count] = pos.y;
+		z[count] = pos.z;
+		health[count] = ai->cheatcb->GetUnitHealth(uid);
+		++count;
+	}
+
+	for (int i = 0; i < count; ++i) {
+		if (id[i] >= 0 && id[i] < (int)indexOfId.size())
+			indexOfId[id[i]] = i;
+	}
+
+	BuildIndex();
+}
+
+
+/// counting sort of friendly units by cell
+void WorldSnapshot::BuildIndex()
+{
+	cellsW = std::max(1, (int)(float3::maxxpos / CELL_SIZE) + 1);
+	cellsH = std::max(1, (int)(float3::maxzpos / CELL_SIZE) + 1);
+	cellStart.assign(cellsW*cellsH + 1, 0);
+	cellUnits.resize(friendCount);
+
+	for (int i = 0; i < friendCount; ++i)
+		++cellStart[CellCoord(x[i], cellsW) + CellCoord(z[i], cellsH)*cellsW + 1];
+	for (size_t c = 1; c < cellStart.size(); ++c)
+		cellStart[c] += cellStart[c-1];
+
+	cellFill.assign(cellStart.begin(), cellStart.end() - 1);
+	for (int i = 0; i < friendCount; ++i)
+		cellUnits[cellFill[CellCoord(x[i], cellsW) + CellCoord(z[i], cellsH)*cellsW]++] = i;
+}
+
+void WorldSnapshot::GetFriendsInRadius(const float3& pos, float radius, std::vector<int>& out) const
+{
+	out.clear();
+	if (cellStart.empty())
+		return;
+
+	const float sqRadius = radius*radius;
+	const int x0 = CellCoord(pos.x - radius, cellsW), x1 = CellCoord(pos.x + radius, cellsW);
+	const int z0 = CellCoord(pos.z - radius, cellsH), z1 = CellCoord(pos.z + radius, cellsH);
+	for (int cz = z0; cz <= z1; ++cz) {
+		for (int cx = x0; cx <= x1; ++cx) {
+			const int cell = cx + cz*cellsW;
+			for (int k = cellStart[cell]; k < cellStart[cell+1]; ++k) {
+				const int i = cellUnits[k];
+				const float dx = x[i] - pos.x, dz = z[i] - pos.z;
+				if (dx*dx + dz*dz < sqRadius)
+					out.push_back(i);
+			}
+		}
+	}
+}
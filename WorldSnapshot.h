@@ -0,0 +1,59 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include "float3.h"
+
+class BaczekKPAI;
+
+/// state of all known units in flat arrays, one index per unit
+///
+/// Friendly units come first, then enemies. The arrays are allocated for
+/// the largest possible unit count up front and never move, so views of
+/// them (see PythonScripting::ExposeWorld) stay valid; only the first
+/// count entries are meaningful.
+///
+/// Friendly units are also bucketed into a grid of CELL_SIZE cells for
+/// radius queries.
+class WorldSnapshot
+{
+public:
+	WorldSnapshot();
+
+	void Update(BaczekKPAI* ai, int frameNum);
+
+	int frame;
+	int count;
+	int friendCount;
+
+	std::vector<int> id;
+	std::vector<int> unitDef; //<! UnitDef id, 0 if unknown
+	std::vector<float> x, y, z;
+	std::vector<float> health;
+
+	size_t capacity() const { return id.size(); }
+
+	/// index of the unit in the arrays, -1 if it's not in the snapshot
+	int IndexOf(int unitId) const
+	{
+		return unitId >= 0 && unitId < (int)indexOfId.size() ? indexOfId[unitId] : -1;
+	}
+
+	/// size of an index cell in elmos
+	static const int CELL_SIZE = 256;
+
+	/// indices of friendly units closer than radius to pos (2D)
+	void GetFriendsInRadius(const float3& pos, float radius, std::vector<int>& out) const;
+
+protected:
+	std::vector<int> indexOfId; //<! by unit id
+
+	int cellsW, cellsH;
+	std::vector<int> cellStart; //<! first cellUnits entry of each cell, and the end
+	std::vector<int> cellUnits; //<! friendly unit indices ordered by cell
+	std::vector<int> cellFill;
+
+	int CellCoord(float v, int cells) const { return std::max(0, std::min(cells - 1, (int)(v / CELL_SIZE))); }
+	void BuildIndex();
+};
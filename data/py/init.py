@@ -47,12 +47,28 @@ default_config = {
         # go straight to enemy base
         'rushBaseUnitCount': 250,
 
+        # formations: elmos between units, row length / row count, and the
+        # largest group matched to slots exactly (bigger ones are greedy)
+        'formationSpacing': 48.0,
+        'formationAspectRatio': 4.0,
+        'formationMaxExact': 100,
+
         # the following values determine when and where to retreat builders
         'builderRetreatMaxDist': 40.0*SQUARE_SIZE,
         'builderRetreatMinDist': 10.0*SQUARE_SIZE,
         'builderRetreatCheckOffset': 10.0*SQUARE_SIZE,
         # influence: <0 - enemy zone, >0 - friendly zone
         'expansionInfluenceLimit': 0,
+        # expansion spots are scored over several frames: microseconds
+        # per frame, and frames after which an unfinished plan is applied
+        # with the spots checked so far (the next one checks the rest first)
+        'plannerBudget': 1000,
+        'plannerMaxAge': 5*GAME_SPEED,
+        # terrain steeper than this (height per elmo) is impassable when
+        # measuring distances from bases to expansion spots
+        'passabilityMaxGradient': 1.0,
+        # microseconds per frame for walking engine paths
+        'pathRequestBudget': 1000,
 
         # units
         'spam_radius': 384.0,
@@ -75,7 +91,22 @@ default_config = {
         # probabilities
         'pr_MOVEOnAttack': 0.1,
 
+        # microseconds per frame for periodic AI tasks, less important
+        # tasks are deferred to later frames when it's exceeded
+        'schedulerBudget': 5000,
+
+        # microseconds a call into this file may take (0 - no limit).
+        # game_frame, world_frame and dump_status are interrupted when they
+        # run over, and after pyHookMaxOverruns more overruns than calls
+        # within budget they run only every pyHookDemotedPeriod frames.
+        # Functions returning a value are never cut short, only logged.
+        'pyHookBudget': 10000,
+        'pyHookMaxOverruns': 3,
+        'pyHookDemotedPeriod': 30,
+
         # debugging
+        # 0 - debug (per unit chatter), 1 - info, 2 - errors only
+        'logLevel': 1,
         'debugDrawLines': 0,
         'debugMessages': 0,
 }
@@ -88,11 +119,21 @@ for k in default_config:
 def get_config_value(name):
     return config.get(name, None)
 
+# the AI reads the config once, change it through here so it notices
+def set_config_value(name, value):
+    config[name] = value
+    pykpai.ConfigChanged()
+
+# The formulas below are used only when formulas.json doesn't define them.
+
 def get_wanted_constructors(geospots, width, height):
     return max(geospots//4, 1)
 
-def get_build_spot_priority(distance, influence, width, height):
-    return int(influence - distance/(width+height)*10)
+# called once per expansion plan with all candidate spots, returns a list
+# of priorities in the same order; without it the AI uses its own formula
+def get_build_spot_priorities(distances, influences, width, height):
+    return [int(infl - dist/(width+height)*10)
+            for dist, infl in zip(distances, influences)]
 
 def get_builder_retreat_timeout(frameNum):
     return frameNum + 10*GAME_SPEED
@@ -101,6 +142,20 @@ def game_frame(teamId, frame):
     import pykpai
     print 'frame:',frame
 
+# Defining world_frame makes the AI fill the unit arrays every frame; it's
+# left out by default to save the work. The buffers in world are owned by
+# the AI and valid only during the call, copy what needs to be kept.
+#
+#def world_frame(teamId, frame, world):
+#    import numpy
+#    n = world['count']
+#    x = numpy.frombuffer(world['x'], dtype=numpy.float32, count=n)
+#    z = numpy.frombuffer(world['z'], dtype=numpy.float32, count=n)
+#    infl = numpy.frombuffer(world['influence'], dtype=numpy.int32)
+#    infl = infl.reshape(world['influence_w'], world['influence_h'])
+#    own = slice(0, world['friend_count'])
+#    print 'friendly centre:', x[own].mean(), z[own].mean()
+
 
 def dump_status(teamId, frame, geos, friends, foes):
     print frame